@@ -0,0 +1,151 @@
+#!/usr/bin/python
+#
+# Performance regression suite over ale-search-bench.
+#
+# Usage: ./scripts/perf_regression.py record <scenarios> <baseline>
+#        ./scripts/perf_regression.py check <scenarios> <baseline> [tolerance]
+#
+# Each line of the scenarios file is a scenario: a name, a ROM, a corpus of
+# root states recorded with -record_root_states, a search method, a step
+# budget (max_sim_steps_per_frame), a seed and more ale options if needed:
+#
+#	pong-iw1	./roms/pong.bin	regression/pong.states	iw1	1500	0
+#	pong-uct	./roms/pong.bin	regression/pong.states	uct	1500	0	-uct_search_depth 30
+#
+# Every scenario is run `repeat` times (3 by default, see -repeat below) and
+# the best throughput and latencies are kept, to filter out noise.
+# `record` writes them to the baseline file. `check` runs the scenarios
+# again and fails (exit status 1) when one of them:
+#   - does not reproduce the baseline exactly: same chosen actions and node
+#     counts on every decision (the digest) and same node totals, or
+#   - generates fewer nodes per second than the baseline minus the tolerance
+#     (default 0.10, i.e. 10%), or
+#   - has a p50 or p99 decision latency above the baseline plus the
+#     tolerance.
+# Budgets must be in steps: wall-clock budgets (max_planning_ms) are not
+# deterministic. Compare baselines recorded on the same host only.
+#
+# Run it from the directory holding the ale-search-bench binary.
+
+from __future__ import print_function
+
+import os
+import sys
+import subprocess
+
+FIELDS = [ 'scenario', 'digest', 'decisions', 'expanded', 'generated',
+		'nodes_per_sec', 'latency_p50', 'latency_p99' ]
+EXACT = [ 'digest', 'decisions', 'expanded', 'generated' ]
+REPEAT = 3
+
+def read_scenarios( path ) :
+	scenarios = []
+	for line in open( path ) :
+		line = line.split( '#' )[0].split()
+		if not line :
+			continue
+		if len( line ) < 6 or len( line ) % 2 != 0 :
+			print( "Bad scenario: %s"%' '.join( line ), file = sys.stderr )
+			sys.exit(1)
+		scenarios.append( line )
+	return scenarios
+
+def run_scenario( scenario ) :
+	name, rom, corpus, method, steps, seed = scenario[:6]
+	command = [ os.path.abspath( './ale-search-bench' ), rom, corpus, method,
+			'-max_sim_steps_per_frame', steps, '-random_seed', seed ]
+	command += scenario[6:]
+	best = None
+	for i in range( REPEAT ) :
+		output = subprocess.check_output( command ).decode()
+		lines = [ l for l in output.splitlines() if l.startswith( 'method=' ) ]
+		if not lines :
+			print( "%s: no result from %s"%( name, ' '.join( command ) ), file = sys.stderr )
+			sys.exit(1)
+		fields = dict( kv.split( '=', 1 ) for kv in lines[0].split( ',' ) )
+		row = dict( ( f, fields[f] ) for f in FIELDS[1:] )
+		row['scenario'] = name
+		if best is None :
+			best = row
+			continue
+		for f in EXACT :
+			if row[f] != best[f] :
+				print( "%s is not deterministic: %s %s != %s"%( name, f, row[f], best[f] ), file = sys.stderr )
+				sys.exit(1)
+		best['nodes_per_sec'] = str( max( float( best['nodes_per_sec'] ), float( row['nodes_per_sec'] ) ) )
+		for f in [ 'latency_p50', 'latency_p99' ] :
+			best[f] = str( min( float( best[f] ), float( row[f] ) ) )
+	return best
+
+def read_baseline( path ) :
+	baseline = {}
+	for line in open( path ) :
+		values = line.rstrip( '\n' ).split( '\t' )
+		if values[0] == 'scenario' :
+			continue
+		baseline[ values[0] ] = dict( zip( FIELDS, values ) )
+	return baseline
+
+def compare( row, base, tolerance ) :
+	failures = []
+	for f in EXACT :
+		if row[f] != base[f] :
+			failures.append( '%s %s, baseline %s'%( f, row[f], base[f] ) )
+	nodes_per_sec = float( row['nodes_per_sec'] )
+	if nodes_per_sec < float( base['nodes_per_sec'] ) * ( 1 - tolerance ) :
+		failures.append( 'nodes_per_sec %.1f, baseline %s'%( nodes_per_sec, base['nodes_per_sec'] ) )
+	for f in [ 'latency_p50', 'latency_p99' ] :
+		if float( row[f] ) > float( base[f] ) * ( 1 + tolerance ) :
+			failures.append( '%s %s ms, baseline %s ms'%( f, row[f], base[f] ) )
+	return failures
+
+def main() :
+	global REPEAT
+
+	args = sys.argv[1:]
+	if len( args ) > 1 and args[0] == '-repeat' :
+		REPEAT = int( args[1] )
+		args = args[2:]
+	if len( args ) < 3 or args[0] not in [ 'record', 'check' ] :
+		print( "Missing parameters!", file = sys.stderr )
+		print( "Usage: ./scripts/perf_regression.py [-repeat n] record|check <scenarios> <baseline> [tolerance]", file = sys.stderr )
+		sys.exit(1)
+
+	mode, scenarios, baseline = args[:3]
+	tolerance = 0.10
+	if len( args ) > 3 :
+		tolerance = float( args[3] )
+	scenarios = read_scenarios( scenarios )
+
+	if mode == 'record' :
+		output = open( baseline, 'w' )
+		output.write( '\t'.join( FIELDS ) + '\n' )
+		for scenario in scenarios :
+			row = run_scenario( scenario )
+			output.write( '\t'.join( row[f] for f in FIELDS ) + '\n' )
+			print( '\t'.join( row[f] for f in FIELDS ) )
+		output.close()
+		return
+
+	base = read_baseline( baseline )
+	failed = 0
+	for scenario in scenarios :
+		name = scenario[0]
+		if name not in base :
+			print( "%s: not in the baseline"%name )
+			failed += 1
+			continue
+		row = run_scenario( scenario )
+		failures = compare( row, base[name], tolerance )
+		if failures :
+			failed += 1
+			print( "FAIL %s: %s"%( name, '; '.join( failures ) ) )
+		else :
+			print( "ok   %s: %s nodes/sec (baseline %s), p99 %s ms (baseline %s)"%( name,
+					row['nodes_per_sec'], base[name]['nodes_per_sec'],
+					row['latency_p99'], base[name]['latency_p99'] ) )
+	print( "%d of %d scenarios failed"%( failed, len( scenarios ) ) )
+	sys.exit( 1 if failed else 0 )
+
+if __name__ == '__main__' :
+	main()
@@ -0,0 +1,59 @@
+#!/bin/bash
+#
+# Scaling curve of the parallel width-based searches.
+#
+# Usage: ./scripts/scaling.sh <ROM_PATH> [parallel_iw1|parallel_piw1] [threads...]
+#
+# Plays the same short episode once per thread count and prints, for each run,
+# the nodes generated per second of planning and the speedup over the first
+# run. Run it from the directory holding the ale binary.
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <ROM_PATH> [parallel_iw1|parallel_piw1] [threads...]" >&2
+    exit 1
+fi
+
+ROM=$1
+METHOD=${2:-parallel_iw1}
+shift
+[ $# -gt 0 ] && shift
+THREADS=${@:-1 2 4 8 16 32}
+
+OUT=scaling-$METHOD-$(basename $ROM .bin)
+mkdir -p $OUT
+rm -f $OUT/scaling.txt
+
+printf "%8s %12s %12s %14s %8s\n" threads generated elapsed nodes/sec speedup
+BASE=""
+for n in $THREADS; do
+    ./ale -display_screen false \
+        -discount_factor 0.995 \
+        -max_sim_steps_per_frame 150000 \
+        -max_num_frames_per_episode 1500 \
+        -max_num_episodes 1 \
+        -random_seed 0 \
+        -player_agent search_agent \
+        -search_method $METHOD \
+        -num_emulator_threads $n \
+        $ROM > $OUT/ale-$n.log 2>&1
+    mv $METHOD.search-agent.trace $OUT/trace-$n
+
+    # Sum generated nodes and planning time over all decisions
+    awk -v n=$n -v base="$BASE" -F, '
+        /^frame=/ {
+            for (i = 1; i <= NF; i++) {
+                split($i, kv, "=")
+                if (kv[1] == "generated") gen += kv[2]
+                if (kv[1] == "elapsed") t += kv[2]
+            }
+        }
+        END {
+            rate = (t > 0 ? gen / t : 0)
+            if (base == "") base = rate
+            printf "%8d %12d %12.2f %14.1f %8.2f\n", n, gen, t, rate, (base > 0 ? rate / base : 0)
+        }' $OUT/trace-$n | tee -a $OUT/scaling.txt
+
+    if [ -z "$BASE" ]; then
+        BASE=$(awk '{print $4}' $OUT/scaling.txt | head -1)
+    fi
+done
@@ -0,0 +1,189 @@
+#!/usr/bin/python
+#
+# Runs a sweep of experiments over a job matrix.
+#
+# Usage: ./scripts/sweep.py <matrix file> <results file> [num_workers]
+#
+# Each line of the matrix file is an ale option followed by the values to
+# sweep, e.g.
+#
+#	rom ./roms/pong.bin ./roms/breakout.bin
+#	search_method iw1 uct
+#	random_seed 0 1 2
+#	max_sim_steps_per_frame 1500
+#
+# Every combination of values is a job. `rom` is the ROM path; every other
+# line becomes `-<option> <value>`. Jobs run as separate ./ale processes, one
+# emulator each, num_workers at a time (default: one per core), each one in
+# its own directory under <results file>.runs, always with the search agent.
+# When a job is done, one line per episode it played is appended to the
+# results file: the job, its exit status, the episode, its score (the
+# "Episode <n> ended, score: <s>" line of ale), frames, decisions,
+# mean/p50/p99 decision latency and nodes generated per second of planning
+# (from the episode's lines of the search agent trace). A job that played no
+# whole episode gets a single line with an empty episode. Jobs that already
+# finished successfully are skipped, so an interrupted sweep resumes where
+# it stopped.
+#
+# Run it from the directory holding the ale binary.
+
+from __future__ import print_function
+
+import os
+import re
+import sys
+import itertools
+import subprocess
+import multiprocessing
+from multiprocessing.pool import ThreadPool
+
+FIELDS = ['job', 'status', 'episode', 'score', 'frames', 'decisions',
+		'latency_mean', 'latency_p50', 'latency_p99', 'nodes_per_sec']
+
+EPISODE_END = re.compile( r'Episode (\d+) ended, score: (-?\d+)' )
+
+def read_matrix( path ) :
+	options = []
+	for line in open( path ) :
+		line = line.split( '#' )[0].split()
+		if line :
+			options.append( ( line[0], line[1:] ) )
+	names = [ name for name, values in options ]
+	jobs = []
+	for values in itertools.product( *[ values for name, values in options ] ) :
+		jobs.append( list( zip( names, values ) ) )
+	return jobs
+
+def job_name( job ) :
+	return ','.join( '%s=%s'%( name, value ) for name, value in job )
+
+def job_dir( job ) :
+	name = job_name( job )
+	for c in '/=,. ' :
+		name = name.replace( c, '_' )
+	return name
+
+def finished_jobs( results ) :
+	done = set()
+	if os.path.exists( results ) :
+		for line in open( results ) :
+			fields = line.rstrip( '\n' ).split( '\t' )
+			# Failed jobs are run again
+			if fields[0] != 'job' and fields[1] == '0' :
+				done.add( fields[0] )
+	return done
+
+def percentile( values, p ) :
+	values = sorted( values )
+	return values[ ( len( values ) - 1 ) * p // 100 ]
+
+def parse_scores( path ) :
+	# Episode number -> score, from the episode ends printed by ale
+	scores = {}
+	if os.path.exists( path ) :
+		for line in open( path ) :
+			match = EPISODE_END.search( line )
+			if match :
+				scores[ int( match.group( 1 ) ) ] = match.group( 2 )
+	return scores
+
+def episode_stats( frames, generated, latencies ) :
+	if not latencies :
+		return [ frames, 0, 0, 0, 0, 0 ]
+	total = sum( latencies )
+	return [ frames, len( latencies ), total / len( latencies ),
+			percentile( latencies, 50 ), percentile( latencies, 99 ),
+			generated / total if total > 0 else 0 ]
+
+def parse_trace( path ) :
+	# One line per decision, frame=...,generated=...,elapsed=..., and one
+	# episode_end=<n>,episode_frames=... line at the end of every episode.
+	# Returns a list of ( episode, stats ).
+	episodes = []
+	generated = 0
+	latencies = []
+	if os.path.exists( path ) :
+		for line in open( path ) :
+			fields = dict( kv.split( '=', 1 ) for kv in line.strip().split( ',' ) if '=' in kv )
+			if 'episode_end' in fields :
+				episodes.append( ( int( fields['episode_end'] ),
+						episode_stats( int( fields['episode_frames'] ), generated, latencies ) ) )
+				generated = 0
+				latencies = []
+			elif line.startswith( 'frame=' ) :
+				generated += int( fields.get( 'generated', 0 ) )
+				latencies.append( float( fields.get( 'elapsed', 0 ) ) )
+	return episodes
+
+def run_job( args ) :
+	job, runs = args
+	rom = None
+	command = [ os.path.abspath( './ale' ), '-display_screen', 'false',
+			'-player_agent', 'search_agent' ]
+	method = None
+	for name, value in job :
+		if name == 'rom' :
+			rom = os.path.abspath( value )
+		else :
+			command += [ '-' + name, value ]
+		if name == 'search_method' :
+			method = value
+	command.append( rom )
+
+	directory = os.path.join( runs, job_dir( job ) )
+	if not os.path.exists( directory ) :
+		os.makedirs( directory )
+	log = open( os.path.join( directory, 'ale.log' ), 'w' )
+	status = subprocess.call( command, cwd = directory, stdout = log, stderr = subprocess.STDOUT )
+	log.close()
+
+	scores = parse_scores( os.path.join( directory, 'ale.log' ) )
+	trace = os.path.join( directory, '%s.search-agent.trace'%method )
+	rows = []
+	for episode, stats in parse_trace( trace ) :
+		rows.append( [ job_name( job ), status, episode, scores.get( episode, '' ) ] + stats )
+	if not rows :
+		rows.append( [ job_name( job ), status, '', '' ] + episode_stats( 0, 0, [] ) )
+	return rows
+
+def main() :
+
+	if len(sys.argv) < 3 :
+		print( "Missing parameters!", file = sys.stderr )
+		print( "Usage: ./scripts/sweep.py <matrix file> <results file> [num_workers]", file = sys.stderr )
+		sys.exit(1)
+
+	matrix = sys.argv[1]
+	results = sys.argv[2]
+	num_workers = multiprocessing.cpu_count()
+	if len(sys.argv) > 3 :
+		num_workers = int( sys.argv[3] )
+
+	jobs = read_matrix( matrix )
+	for job in jobs :
+		if 'rom' not in [ name for name, value in job ] :
+			print( "The matrix has no rom line", file = sys.stderr )
+			sys.exit(1)
+	done = finished_jobs( results )
+	pending = [ job for job in jobs if job_name( job ) not in done ]
+	print( "%d jobs, %d already done, %d workers"%( len( jobs ), len( jobs ) - len( pending ), num_workers ) )
+
+	runs = os.path.abspath( results + '.runs' )
+	new_file = not os.path.exists( results )
+	output = open( results, 'a' )
+	if new_file :
+		output.write( '\t'.join( FIELDS ) + '\n' )
+		output.flush()
+
+	pool = ThreadPool( num_workers )
+	for i, rows in enumerate( pool.imap_unordered( run_job, [ ( job, runs ) for job in pending ] ) ) :
+		for row in rows :
+			output.write( '\t'.join( str( x ) for x in row ) + '\n' )
+		output.flush()
+		print( "[%d/%d] %s: %d episodes"%( i + 1, len( pending ), rows[0][0], len( [ row for row in rows if row[2] != '' ] ) ) )
+	pool.close()
+	pool.join()
+	output.close()
+
+if __name__ == '__main__' :
+	main()
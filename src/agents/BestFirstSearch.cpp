@@ -251,7 +251,7 @@ void BestFirstSearch::expand_tree(TreeNode* start_node) {
 	if (!start_node->v_children.empty()) {
 		start_node->updateTreeNode();
 		num_simulated_steps += reuse_branch(start_node);
-		std::cout << "Num_reused_steps: " << num_simulated_steps << std::endl;
+		LOG(LOG_DEBUG, "Num_reused_steps: %d\n", num_simulated_steps);
 		num_simulated_steps = 0;
 		//COMMENT LINES BELOW, AND UNCOMMENT ABOVE TO WORKSHOP STYLE. ALSO CHANGE FN NOVEL 2ND QUEUE
 		//reset_branch( start_node );
@@ -323,25 +323,26 @@ void BestFirstSearch::expand_tree(TreeNode* start_node) {
 		// std::cout << "q_exploration size: "<< q_exploration.size() << std::endl;
 		// std::cout << "q_exploitation size: "<< q_exploitation.size() << std::endl;
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	}
 
-	std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-	std::cout << "\tExpanded Novelty 1: " << m_exp_count_novelty1 << std::endl;
-	std::cout << "\tExpanded Novelty 2: " << m_exp_count_novelty2 << std::endl;
-	std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-	std::cout << "\tGenerated so far: " << m_generated_nodes << std::endl;
-	std::cout << "\tGenerated Novelty 1: " << m_gen_count_novelty1 << std::endl;
-	std::cout << "\tGenerated Novelty 2: " << m_gen_count_novelty2 << std::endl;
+	LOG(LOG_DEBUG, "\tExpanded so far: %u\n", m_expanded_nodes);
+	LOG(LOG_DEBUG, "\tExpanded Novelty 1: %u\n", m_exp_count_novelty1);
+	LOG(LOG_DEBUG, "\tExpanded Novelty 2: %u\n", m_exp_count_novelty2);
+	LOG(LOG_DEBUG, "\tPruned so far: %u\n", m_pruned_nodes);
+	LOG(LOG_DEBUG, "\tGenerated so far: %u\n", m_generated_nodes);
+	LOG(LOG_DEBUG, "\tGenerated Novelty 1: %u\n", m_gen_count_novelty1);
+	LOG(LOG_DEBUG, "\tGenerated Novelty 2: %u\n", m_gen_count_novelty2);
 
 	if (q_exploration->empty() && q_exploitation->empty())
-		std::cout << "Search Space Exhausted!" << std::endl;
-	std::cout << "q_exploration size: " << q_exploration->size() << std::endl;
-	std::cout << "q_exploitation size: " << q_exploitation->size() << std::endl;
+		LOG(LOG_DEBUG, "Search Space Exhausted!\n");
+	LOG(LOG_DEBUG, "q_exploration size: %zu\n", q_exploration->size());
+	LOG(LOG_DEBUG, "q_exploitation size: %zu\n", q_exploitation->size());
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
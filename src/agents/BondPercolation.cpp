@@ -271,9 +271,9 @@ void BondPercolation::expand_tree(TreeNode* start_node) {
 
 	do {
 
-		std::cout << "# Pivots: " << pivots.size() << std::endl;
-		std::cout << "First pivot reward: " << pivots.front()->node_reward
-				<< std::endl;
+		LOG(LOG_TRACE, "# Pivots: %zu\n", pivots.size());
+		LOG(LOG_TRACE, "First pivot reward: %g\n",
+				(double) pivots.front()->node_reward);
 		pivots.front()->m_depth = 0;
 		TreeNode* piv = pivots.front();
 		int steps = 0;
@@ -283,7 +283,7 @@ void BondPercolation::expand_tree(TreeNode* start_node) {
 //		int steps = expand_node(pivots.front());
 		num_simulated_steps += steps;
 
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
@@ -307,25 +307,26 @@ void BondPercolation::expand_tree(TreeNode* start_node) {
 			steps = expand_node(curr_node, action);
 			num_simulated_steps += steps;
 			// Stop once we have simulated a maximum number of steps
-			if (num_simulated_steps >= max_sim_steps_per_frame) {
+			if (budget_spent(num_simulated_steps)) {
 				break;
 			}
 
 		}
-		std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-		std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-		std::cout << "\tGenerated so far: " << m_generated_nodes << std::endl;
+		LOG(LOG_TRACE, "\tExpanded so far: %u\n", m_expanded_nodes);
+		LOG(LOG_TRACE, "\tPruned so far: %u\n", m_pruned_nodes);
+		LOG(LOG_TRACE, "\tGenerated so far: %u\n", m_generated_nodes);
 
 		if (m_q_percolation->empty())
-			std::cout << "Search Space Exhausted!" << std::endl;
+			LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	} while (!pivots.empty());
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -396,11 +397,10 @@ bool BondPercolation::check_novelty_1(ALEState& machine_state) {
 }
 
 const ALEScreen BondPercolation::get_screen(ALEState &machine_state) {
-	ALEState buffer = m_env->cloneState();
-	m_env->restoreState(machine_state);
-	const ALEScreen screen = m_env->buildAndGetScreen();
-	m_env->restoreState(buffer);
-	return screen;
+	// Every simulation restores its own start state, so m_env does not
+	// need to be put back; usually it already holds the child just simulated
+	load_state(m_env, machine_state);
+	return m_env->buildAndGetScreen();
 }
 
 void BondPercolation::clear() {
@@ -524,6 +524,7 @@ void BondPercolation::print_frame_data(int frame_number, float elapsed,
 	output << ",elapsed=" << elapsed;
 	output << ",total_simulation_steps=" << total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
+	print_profile_data(output);
 	m_rom_settings->print(output);
 	output << std::endl;
 }
@@ -104,6 +104,26 @@ void BreadthFirstSearch::expand_tree(TreeNode* start_node) {
 			}
 		}
 
+		// Create the children of a leaf up front and simulate them together
+		// (on the emulator pool if there is one). They are attached to the
+		// tree one by one below, in action order.
+		NodeList generated;
+		if (leaf_node) {
+			generated.resize(num_actions);
+			for (int a = 0; a < num_actions; a++) {
+				Action act = available_actions[a];
+				if (action_sequence_detection && curr_node != p_root
+						&& !isUsefulAction[act]) {
+					generated[a] = new TreeNode(curr_node, curr_node->state,
+							this, act, 0);
+				} else {
+					generated[a] = prepare_child(curr_node, act,
+							sim_steps_per_node);
+				}
+			}
+			simulate_children();
+		}
+
 		for (int a = 0; a < num_actions; a++) {
 			Action act = available_actions[a];
 
@@ -119,9 +139,7 @@ void BreadthFirstSearch::expand_tree(TreeNode* start_node) {
 							//					printf("Pruned %d\n", (int) a,
 							//							action_to_string((Action) a).c_str());
 							// TODO: generate dummy node
-							TreeNode * child;
-							child = new TreeNode(curr_node, curr_node->state,
-									this, act, 0);
+							TreeNode * child = generated[a];
 							curr_node->v_children[a] = child;
 							child->is_terminal = true;
 							continue;
@@ -130,8 +148,7 @@ void BreadthFirstSearch::expand_tree(TreeNode* start_node) {
 				}
 
 				m_generated_nodes++;
-				child = new TreeNode(curr_node, curr_node->state, this, act,
-						sim_steps_per_node);
+				child = generated[a];
 
 				// TODO: BreadthFirstSearch needs to be split into two classes
 				// the new one encapsulating the novelty-based search algorithm
@@ -158,15 +175,16 @@ void BreadthFirstSearch::expand_tree(TreeNode* start_node) {
 		}
 
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	}
 
 	if (q.empty())
-		std::cout << "Search Space Exhausted!" << std::endl;
+		LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -263,5 +281,6 @@ void BreadthFirstSearch::print_frame_data(int frame_number, float elapsed,
 	output << ",total_simulation_steps=" << m_total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
 	output << ",context_switching_time=" << m_context_time;
+	print_profile_data(output);
 	output << std::endl;
 }
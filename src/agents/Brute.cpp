@@ -58,8 +58,7 @@ void Brute::update_tree(void) {
 	m_max_depth = 0;
 	int simulation_steps = ((BruteTreeNode*) p_root)->num_steps();
 
-	std::cout << "starting with " << simulation_steps << " simulation steps"
-			<< std::endl;
+	LOG(LOG_DEBUG, "starting with %d simulation steps\n", simulation_steps);
 
 	int num_iterations = 0;
 	while (true) {
@@ -71,23 +70,26 @@ void Brute::update_tree(void) {
 		//  of frames
 		if (max_sim_steps_per_frame != -1
 				&& simulation_steps >= max_sim_steps_per_frame) {
-			printf(
+			LOG(LOG_DEBUG,
 					"break by max_sim_steps_per_frame: %d simulation_steps >= %d\n",
 					simulation_steps, max_sim_steps_per_frame);
 			break;
+		} else if (out_of_time()) {
+			LOG(LOG_DEBUG, "break by max_planning_ms: %d ms\n",
+					m_max_planning_ms);
+			break;
 		}
 
 		// Handle the case where we cannot simulate further but have not reached the
 		//  maximum number of simulation steps per frame (thanks to Erik Talvitie
 		//  for this one)
 		else if (num_simulations_per_frame == -1 && new_sim_steps == 0) {
-			printf("new_sim_steps == 0\n");
+			LOG(LOG_DEBUG, "new_sim_steps == 0\n");
 			break;
 		}
 	}
-	std::cout << "Simulation steps: " << simulation_steps << std::endl;
-	std::cout << "Visits to root: " << ((BruteTreeNode*) p_root)->visit_count
-			<< std::endl;
+	LOG(LOG_DEBUG, "Simulation steps: %d\n", simulation_steps);
+	LOG(LOG_DEBUG, "Visits to root: %d\n", ((BruteTreeNode*) p_root)->visit_count);
 	total_simulation_steps += simulation_steps;
 
 //	print_tree();
@@ -129,17 +131,19 @@ Action Brute::get_best_action(void) {
 	// Replace the best branch by our actual choice 
 	p_root->best_branch = best_branch;
 
-	for (size_t c = 0; c < p_root->v_children.size(); c++) {
-		TreeNode* curr_child = p_root->v_children[c];
-
-		std::cout << "Action: " << action_to_string(available_actions[c])
-				<< " Depth: " << curr_child->branch_depth << " NumNodes: "
-				<< curr_child->num_nodes() << " Reward: "
-				<< curr_child->branch_return << std::endl;
+	// num_nodes() walks the whole subtree: only when the line is printed
+	if (Logger::enabled(LOG_DEBUG)) {
+		for (size_t c = 0; c < p_root->v_children.size(); c++) {
+			TreeNode* curr_child = p_root->v_children[c];
 
+			LOG(LOG_DEBUG, "Action: %s Depth: %g NumNodes: %d Reward: %g\n",
+					action_to_string(available_actions[c]).c_str(),
+					(double) curr_child->branch_depth, curr_child->num_nodes(),
+					(double) curr_child->branch_return);
+		}
 	}
 
-	std::cout << "Action " << best_branch << std::endl;
+	LOG(LOG_DEBUG, "Action %d\n", best_branch);
 	return available_actions[best_branch];
 }
 
@@ -211,7 +215,7 @@ int Brute::single_brute_iteration(void) {
 			m_max_depth = node->depth();
 
 		if (!node->initialized) {
-			printf("uninitialized\n");
+			LOG(LOG_TRACE, "uninitialized\n");
 			node->init(this, leaf_choice, sim_steps_per_node);
 		}
 
@@ -161,7 +161,7 @@ void BruteBrFS::expand_tree(TreeNode* start_node) {
 		}
 
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
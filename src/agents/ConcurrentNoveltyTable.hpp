@@ -0,0 +1,101 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ConcurrentNoveltyTable.hpp
+ *
+ *  Novelty table shared by the workers of a parallel width-based search.
+ *  Updates are lock-free: IW(1) keeps one bit per feature, set with an atomic
+ *  fetch-or, and p-IW(1) keeps the best accumulated reward per feature, raised
+ *  with a compare-and-swap loop.
+ **************************************************************************** */
+
+#ifndef __CONCURRENT_NOVELTY_TABLE_HPP__
+#define __CONCURRENT_NOVELTY_TABLE_HPP__
+
+#include <atomic>
+#include <limits>
+#include <memory>
+
+class ConcurrentNoveltyTable {
+public:
+	ConcurrentNoveltyTable() :
+			m_num_features(0), m_num_words(0) {
+	}
+
+	/** Allocates room for n features. bit_table selects the IW(1) table,
+	 *  otherwise a reward table is used. The table starts cleared. */
+	void resize(size_t n, bool bit_table) {
+		m_num_features = n;
+		if (bit_table) {
+			m_num_words = (n + 63) / 64;
+			m_bits.reset(new std::atomic<unsigned long long>[m_num_words]);
+			m_rewards.reset();
+		} else {
+			m_num_words = 0;
+			m_bits.reset();
+			m_rewards.reset(new std::atomic<int>[n]);
+		}
+		clear();
+	}
+
+	/** Not safe to call while workers are using the table */
+	void clear() {
+		for (size_t i = 0; i < m_num_words; ++i) {
+			m_bits[i].store(0, std::memory_order_relaxed);
+		}
+		if (m_rewards) {
+			for (size_t i = 0; i < m_num_features; ++i) {
+				m_rewards[i].store(std::numeric_limits<int>::min(),
+						std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/** Sets feature i. Returns true if this call set it, i.e. nobody had
+	 *  seen the feature before. */
+	bool test_and_set(size_t i) {
+		unsigned long long mask = 1ULL << (i % 64);
+		return (m_bits[i / 64].fetch_or(mask, std::memory_order_relaxed)
+				& mask) == 0;
+	}
+
+	/** Raises the reward recorded for feature i to reward. Returns true if
+	 *  reward is strictly better than anything recorded so far. */
+	bool raise(size_t i, int reward) {
+		int current = m_rewards[i].load(std::memory_order_relaxed);
+		while (reward > current) {
+			if (m_rewards[i].compare_exchange_weak(current, reward,
+					std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t size() const {
+		return m_num_features;
+	}
+
+	/** Bytes held by the table */
+	size_t bytes() const {
+		if (m_bits)
+			return m_num_words * sizeof(std::atomic<unsigned long long>);
+		if (m_rewards)
+			return m_num_features * sizeof(std::atomic<int>);
+		return 0;
+	}
+
+private:
+	size_t m_num_features;
+	size_t m_num_words;
+	std::unique_ptr<std::atomic<unsigned long long>[]> m_bits;
+	std::unique_ptr<std::atomic<int>[]> m_rewards;
+};
+
+#endif // __CONCURRENT_NOVELTY_TABLE_HPP__
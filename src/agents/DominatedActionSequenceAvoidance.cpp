@@ -80,12 +80,13 @@ void DominatedActionSequenceAvoidance::learnDominatedActionSequences(
 }
 
 std::vector<bool> DominatedActionSequenceAvoidance::getEffectiveActions(
-		std::vector<Action> previousActions, int current_frame) {
+		std::vector<Action> previousActions, int current_frame,
+		std::mt19937* rng) {
 	if (junk_decision_frame > current_frame) {
 		return vector<bool>(PLAYER_A_MAX, true);
 	}
 
-	return getDASAActionSet(previousActions);
+	return getDASAActionSet(previousActions, rng);
 }
 
 int DominatedActionSequenceAvoidance::getDetectedUsedActionsSize() {
@@ -165,7 +166,7 @@ std::vector<double> DominatedActionSequenceAvoidance::novelty_to_probabilities(
 }
 
 std::vector<bool> DominatedActionSequenceAvoidance::getDASAActionSet(
-		std::vector<Action> previousActions) {
+		std::vector<Action> previousActions, std::mt19937* rng) {
 	int size = num_sequences(previousActions.size() + 1);
 	std::vector<bool> ret(PLAYER_A_MAX, false);
 //	std::vector<double> qvalues = qvalues_by_action;
@@ -175,7 +176,11 @@ std::vector<bool> DominatedActionSequenceAvoidance::getDASAActionSet(
 		std::vector<Action> seq = previousActions;
 		seq.push_back((Action) a);
 		double probability = probabilty_by_action[seqToInt(seq)];
-		double random = (double) rand() / (double) RAND_MAX;
+		double random;
+		if (rng != NULL)
+			random = (double) (*rng)() / (double) rng->max();
+		else
+			random = (double) rand() / (double) RAND_MAX;
 //		printf("p=%.1f, r=%.1f\n", probability, random);
 		if (random < probabilty_by_action[a]) {
 			ret[a] = true;
@@ -282,39 +287,24 @@ void DominatedActionSequenceAvoidance::getUsedSequenceList(TreeNode* node,
 		int seqLength, std::vector<bool>& isSequenceUsed) {
 
 	int size = num_sequences(seqLength);
-	std::vector<TreeNode*> nodeList;
+	getResultingNodes(node, seqLength);
+	const std::vector<TreeNode*>& nodeList = m_resulting_nodes;
 
-	for (int i = 0; i < size; ++i) {
-		vector<Action> seq = intToSeq(i, seqLength);
-		for (int j = 0; j < seq.size(); ++j) {
-			seq[j] = action_permutation[seq[j]];
-		}
-		TreeNode* child = getResultingNode(node, seq);
-		nodeList.push_back(child);
-
-	}
+	// Terminal nodes are not learned from, but they count as duplicates
+	std::vector<int>& earlier = m_earlier_duplicate;
+	std::vector<int>& other = m_other_duplicate;
+	findDuplicates(nodeList, earlier, other);
 
 	for (int i = 0; i < size; ++i) {
 		if (nodeList[i] == nullptr || nodeList[i]->is_terminal) {
 			continue;
 		}
 
-		bool isDuplicate = false;
-		for (int j = 0; j < i; ++j) {
-			if (nodeList[j] == nullptr || nodeList[i]->is_terminal) {
-				continue;
-			}
-
-			// ODO
-			if (nodeList[i]->state.equals(nodeList[j]->state)) {
-				isDuplicate = true;
-				break;
-			}
-		}
+		bool isDuplicate = (earlier[i] != -1);
 		assert(num_duplicate_node_by_action[0].size() > 0);
 		assert(num_novel_node_by_action[0].size() > 0);
 
-		int sInt = permutateToOriginalAction(i, seqLength);
+		int sInt = m_sequence_codes[i];
 		if (isDuplicate) {
 //			printf("acion dupped; %d\n", sInt);
 			num_duplicate_node_by_action[seqLength - 1][num_duplicate_node_by_action[seqLength
@@ -334,23 +324,12 @@ void DominatedActionSequenceAvoidance::getUsedSequenceList(TreeNode* node,
 		if (nodeList[i] == nullptr || nodeList[i]->is_terminal) {
 			continue;
 		}
-		int iInt = permutateToOriginalAction(i, seqLength);
+		int iInt = m_sequence_codes[i];
 
-		bool isDuplicate = false;
-		for (int j = 0; j < size; ++j) {
-			if (j == i) {
-				continue;
-			}
-			if (nodeList[j] == nullptr || nodeList[i]->is_terminal) {
-				continue;
-			}
-
-			if (nodeList[i]->state.equals(nodeList[j]->state)) {
-				isDuplicate = true;
-				int jInt = permutateToOriginalAction(j, seqLength);
-				dominance_graph[seqLength - 1].addEdge(iInt, jInt);
-				break;
-			}
+		bool isDuplicate = (other[i] != -1);
+		if (isDuplicate) {
+			int jInt = m_sequence_codes[other[i]];
+			dominance_graph[seqLength - 1].addEdge(iInt, jInt);
 		}
 		if (!isDuplicate) {
 			dominance_graph[seqLength - 1].addNode(iInt);
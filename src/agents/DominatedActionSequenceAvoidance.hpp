@@ -18,7 +18,8 @@ public:
 	void learnDominatedActionSequences(SearchTree* tree, int seqLength);
 
 	std::vector<bool> getEffectiveActions(
-			std::vector<Action> previousActions, int current_frame);
+			std::vector<Action> previousActions, int current_frame,
+			std::mt19937* rng = NULL);
 	int getDetectedUsedActionsSize();
 
 protected:
@@ -30,7 +31,8 @@ private:
 	/**
 	 * Dominated Action Sequence Avoidance
 	 */
-	std::vector<bool> getDASAActionSet(std::vector<Action> previousActions);
+	std::vector<bool> getDASAActionSet(std::vector<Action> previousActions,
+			std::mt19937* rng);
 	std::vector<double> getQvaluesOfNextActions(
 			std::vector<Action> previousActions);
 	std::vector<double> getQvaluesOfAllSequences(int seqLength);
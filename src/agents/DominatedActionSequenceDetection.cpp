@@ -55,10 +55,28 @@ void DominatedActionSequenceDetection::searchNode(TreeNode* node, int seqLength,
 // 1. get actionList for the node
 	getUsedSequenceList(node, seqLength, isSequenceUsed);
 
-// 2. recursively call this for child nodes
-	NodeList childList = sortNodeList(node->v_children);
-	for (int i = 0; i < childList.size(); ++i) {
-		searchNode(childList[i], seqLength, isSequenceUsed);
+// 2. recursively call this for child nodes, by increasing action. They
+// are almost always stored in that order: then the list is walked as is.
+	const NodeList& children = node->v_children;
+	bool sorted = true;
+	for (size_t i = 1; i < children.size(); ++i) {
+		if (children[i]->act < children[i - 1]->act) {
+			sorted = false;
+			break;
+		}
+	}
+	if (sorted) {
+		for (size_t i = 0; i < children.size(); ++i) {
+			searchNode(children[i], seqLength, isSequenceUsed);
+		}
+		return;
+	}
+	for (int a = 0; a < PLAYER_A_MAX; ++a) {
+		for (size_t i = 0; i < children.size(); ++i) {
+			if (children[i]->act == a) {
+				searchNode(children[i], seqLength, isSequenceUsed);
+			}
+		}
 	}
 }
 
@@ -83,48 +101,41 @@ std::vector<Action> DominatedActionSequenceDetection::intToSeq(int seqInt,
 	return sequence;
 }
 
-bool nodeActionSort(const TreeNode* l, const TreeNode* r) {
-	return l->act < r->act;
-}
-
-NodeList DominatedActionSequenceDetection::sortNodeList(NodeList childList) {
-	NodeList sortedList = childList;
-	std::sort(sortedList.begin(), sortedList.end(), nodeActionSort);
-	return sortedList;
+void DominatedActionSequenceDetection::getResultingNodes(TreeNode* node,
+		int seqLength) {
+	for (int p = 0; p < PLAYER_A_MAX; ++p) {
+		m_action_digit[action_permutation[p]] = p;
+	}
+	for (int a = 0; a < PLAYER_A_MAX; ++a) {
+		m_action_code[a] =
+				permutate_action ? m_action_digit[m_action_digit[a]] : a;
+	}
+	int size = num_sequences(seqLength);
+	m_resulting_nodes.assign(size, nullptr);
+	m_sequence_codes.assign(size, -1);
+	collectResultingNodes(node, 0, seqLength, 0, 0);
 }
 
-TreeNode * DominatedActionSequenceDetection::getResultingNode(TreeNode * root,
-		std::vector<Action> sequence) {
-	TreeNode* curr = root;
-	int currPath = 0;
-
-	while (currPath < sequence.size()) {
-		if (curr->is_leaf()) {
-			return nullptr;
-		}
-		NodeList r = curr->v_children;
-		assert(r.size() > 0);
-		assert(0 <= sequence[currPath] && sequence[currPath] < PLAYER_A_MAX);
-
-		bool found = false;
-		for (int i = 0; i < r.size(); ++i) {
-			if (r[i]->act == sequence[currPath]) {
-				curr = r[i];
-				currPath++;
-				found = true;
-				break;
-			}
-		}
-		if (!found) {
-			return nullptr;
-		}
+void DominatedActionSequenceDetection::collectResultingNodes(TreeNode* curr,
+		int depth, int seqLength, int index, int code) {
+	if (depth == seqLength) {
+		m_resulting_nodes[index] = curr;
+		m_sequence_codes[index] = code;
+		return;
 	}
-
-	if (currPath == sequence.size()) {
-		return curr;
-	} else {
-
-		return nullptr;
+	// Only the first child of each action is followed
+	unsigned followed = 0;
+	for (size_t i = 0; i < curr->v_children.size(); ++i) {
+		TreeNode* child = curr->v_children[i];
+		int a = child->act;
+		assert(0 <= a && a < PLAYER_A_MAX);
+		if (followed & (1u << a)) {
+			continue;
+		}
+		followed |= 1u << a;
+		collectResultingNodes(child, depth + 1, seqLength,
+				index * PLAYER_A_MAX + m_action_digit[a],
+				code * PLAYER_A_MAX + m_action_code[a]);
 	}
 }
 
@@ -140,6 +151,72 @@ int DominatedActionSequenceDetection::num_sequences(int seqLength) const {
 	return size;
 }
 
+// FNV-1a over the RAM: states that are equal have the same RAM
+static uint64_t state_hash(ALEState& state) {
+	ALERAM ram = state.getRAM();
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < ram.size(); ++i) {
+		hash = (hash ^ ram.get(i)) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+void DominatedActionSequenceDetection::findDuplicates(
+		const std::vector<TreeNode*>& nodes, std::vector<int>& earlier,
+		std::vector<int>& other) {
+	m_state_classes.clear();
+	m_classes_by_hash.clear();
+	m_class_of.assign(nodes.size(), -1);
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i] == nullptr) {
+			continue;
+		}
+		uint64_t hash = state_hash(nodes[i]->state);
+		std::unordered_map<uint64_t, int>::iterator head =
+				m_classes_by_hash.find(hash);
+		int c = (head == m_classes_by_hash.end() ? -1 : head->second);
+		for (; c != -1; c = m_state_classes[c].next) {
+			TreeNode* first = nodes[m_state_classes[c].first];
+			if (nodes[i]->state.equals(first->state)) {
+				break;
+			}
+		}
+		if (c == -1) {
+			StateClass added;
+			added.first = i;
+			added.second = -1;
+			added.next = -1;
+			if (head != m_classes_by_hash.end()) {
+				added.next = head->second;
+				head->second = m_state_classes.size();
+			} else {
+				m_classes_by_hash[hash] = m_state_classes.size();
+			}
+			c = m_state_classes.size();
+			m_state_classes.push_back(added);
+		} else if (m_state_classes[c].second == -1) {
+			m_state_classes[c].second = i;
+		}
+		m_class_of[i] = c;
+	}
+
+	earlier.assign(nodes.size(), -1);
+	other.assign(nodes.size(), -1);
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (m_class_of[i] == -1) {
+			continue;
+		}
+		const StateClass& c = m_state_classes[m_class_of[i]];
+		if (c.first == (int) i) {
+			other[i] = c.second;
+		} else {
+			earlier[i] = c.first;
+			other[i] = c.first;
+		}
+	}
+}
+
 // Action permutation
 int DominatedActionSequenceDetection::permutateToOriginalAction(int input,
 		int seqLength) {
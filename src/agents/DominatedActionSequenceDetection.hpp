@@ -12,6 +12,9 @@
 #include "Constants.h"
 #include "VertexCover.hpp"
 #include "../ale_interface.hpp"
+#include <stdint.h>
+#include <random>
+#include <unordered_map>
 //#include "SearchTree.hpp"
 
 class SearchTree;
@@ -26,8 +29,14 @@ public:
 	virtual void learnDominatedActionSequences(SearchTree* tree,
 			int seqLength) = 0;
 
+	/* *********************************************************************
+	 Actions worth trying after previousActions. Avoidance draws the set at
+	 random: from rng if given, so that concurrent rollouts can each pass
+	 their own, and from rand() otherwise.
+	 ******************************************************************* */
 	virtual std::vector<bool> getEffectiveActions(
-			std::vector<Action> previousActions, int current_frame) = 0;
+			std::vector<Action> previousActions, int current_frame,
+			std::mt19937* rng = NULL) = 0;
 	virtual int getDetectedUsedActionsSize() = 0;
 
 protected:
@@ -43,11 +52,29 @@ protected:
 	int seqToInt(std::vector<Action> sequence);
 	std::vector<Action> intToSeq(int seqInt, int seqLength);
 
-	std::vector<TreeNode*> sortNodeList(std::vector<TreeNode*> childList);
-	TreeNode* getResultingNode(TreeNode* root, std::vector<Action> sequence);
-
 	int num_sequences(int seqLength) const;
 
+	/* *********************************************************************
+	 Fills m_resulting_nodes[i] with the node reached from node by the i-th
+	 sequence of seqLength actions, in action_permutation order (NULL if it
+	 is not in the tree), and m_sequence_codes[i] with
+	 permutateToOriginalAction(i, seqLength). One DFS bounded by seqLength,
+	 with the sequence codes built along the way.
+	 ******************************************************************* */
+	void getResultingNodes(TreeNode* node, int seqLength);
+	void collectResultingNodes(TreeNode* curr, int depth, int seqLength,
+			int index, int code);
+
+	/* *********************************************************************
+	 Groups the non-null entries of nodes by state. For each entry i,
+	 earlier[i] is the first entry before i with the same state and other[i]
+	 the first entry other than i with the same state (-1 if none, or if i
+	 is null). Nodes are hashed by RAM, so only the nodes sharing a hash are
+	 compared: linear in the number of nodes instead of quadratic.
+	 ******************************************************************* */
+	void findDuplicates(const std::vector<TreeNode*>& nodes,
+			std::vector<int>& earlier, std::vector<int>& other);
+
 	std::vector<std::vector<bool> > isUsefulActionSequence;
 
 
@@ -61,6 +88,28 @@ protected:
 
 	std::vector<VertexCover> dominance_graph;
 
+	// Scratch space of findDuplicates(): the states seen so far, chained
+	// by hash. Kept across calls so that they do not allocate.
+	struct StateClass {
+		int first; // first entry with the state
+		int second; // second one, -1 if none yet
+		int next; // next class with the same hash, -1 if none
+	};
+	std::vector<StateClass> m_state_classes;
+	std::vector<int> m_class_of; // class of each entry, -1 if null
+	std::unordered_map<uint64_t, int> m_classes_by_hash;
+
+	// Output of getResultingNodes() and findDuplicates() for the node
+	// getUsedSequenceList() is called on, kept across calls
+	std::vector<TreeNode*> m_resulting_nodes;
+	std::vector<int> m_sequence_codes;
+	std::vector<int> m_earlier_duplicate;
+	std::vector<int> m_other_duplicate;
+	// Position of each action in action_permutation, and the digit it
+	// stands for in permutateToOriginalAction()
+	int m_action_digit[PLAYER_A_MAX];
+	int m_action_code[PLAYER_A_MAX];
+
 	int permutateToOriginalAction(int input, int seqLength);
 	bool permutate_action;
 	std::vector<Action> action_permutation;
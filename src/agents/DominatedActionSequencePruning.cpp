@@ -54,7 +54,8 @@ void DominatedActionSequencePruning::learnDominatedActionSequences(
 }
 
 std::vector<bool> DominatedActionSequencePruning::getEffectiveActions(
-		std::vector<Action> previousActions, int current_frame) {
+		std::vector<Action> previousActions, int current_frame,
+		std::mt19937* rng) {
 	if (junk_decision_frame > current_frame) {
 		return vector<bool>(PLAYER_A_MAX, true);
 	}
@@ -107,38 +108,20 @@ void DominatedActionSequencePruning::getUsedSequenceList(TreeNode* node,
 		int seqLength, std::vector<bool>& isSequenceUsed) {
 
 	int size = num_sequences(seqLength);
-	std::vector<TreeNode*> nodeList;
+	getResultingNodes(node, seqLength);
+	const std::vector<TreeNode*>& nodeList = m_resulting_nodes;
 
-	for (int i = 0; i < size; ++i) {
-		vector<Action> seq = intToSeq(i, seqLength);
-		for (int j = 0; j < seq.size(); ++j) {
-			seq[j] = action_permutation[seq[j]];
-		}
-		TreeNode* child = getResultingNode(node, seq);
-		nodeList.push_back(child);
-
-	}
+	// Terminal nodes are not learned from, but they count as duplicates
+	std::vector<int>& earlier = m_earlier_duplicate;
+	std::vector<int>& other = m_other_duplicate;
+	findDuplicates(nodeList, earlier, other);
 
-//	printf("\n");
-	// TODO: this is wrong: we are adding nulls!
 	for (int i = 0; i < size; ++i) {
 		if (nodeList[i] == nullptr || nodeList[i]->is_terminal) {
 			continue;
 		}
-
-		bool isDuplicate = false;
-		for (int j = 0; j < i; ++j) {
-			if (nodeList[j] == nullptr || nodeList[i]->is_terminal) {
-				continue;
-			}
-
-			if (nodeList[i]->state.equals(nodeList[j]->state)) {
-				isDuplicate = true;
-				break;
-			}
-		}
-		if (!isDuplicate) {
-			int sInt = permutateToOriginalAction(i, seqLength);
+		if (earlier[i] == -1) {
+			int sInt = m_sequence_codes[i];
 			isSequenceUsed[sInt] = true;
 		}
 	}
@@ -149,23 +132,12 @@ void DominatedActionSequencePruning::getUsedSequenceList(TreeNode* node,
 		if (nodeList[i] == nullptr || nodeList[i]->is_terminal) {
 			continue;
 		}
-		int iInt = permutateToOriginalAction(i, seqLength);
+		int iInt = m_sequence_codes[i];
 
-		bool isDuplicate = false;
-		for (int j = 0; j < size; ++j) {
-			if (j == i) {
-				continue;
-			}
-			if (nodeList[j] == nullptr || nodeList[i]->is_terminal) {
-				continue;
-			}
-
-			if (nodeList[i]->state.equals(nodeList[j]->state)) {
-				isDuplicate = true;
-				int jInt = permutateToOriginalAction(j, seqLength);
-				dominance_graph[seqLength - 1].addEdge(iInt, jInt);
-				break;
-			}
+		bool isDuplicate = (other[i] != -1);
+		if (isDuplicate) {
+			int jInt = m_sequence_codes[other[i]];
+			dominance_graph[seqLength - 1].addEdge(iInt, jInt);
 		}
 		if (!isDuplicate) {
 			dominance_graph[seqLength - 1].addNode(iInt);
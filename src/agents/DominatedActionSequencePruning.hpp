@@ -19,7 +19,8 @@ public:
 	void learnDominatedActionSequences(SearchTree* tree, int seqLength);
 
 	std::vector<bool> getEffectiveActions(
-			std::vector<Action> previousActions, int current_frame);
+			std::vector<Action> previousActions, int current_frame,
+			std::mt19937* rng = NULL);
 	int getDetectedUsedActionsSize();
 
 protected:
@@ -0,0 +1,149 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  EmulatorPool.cpp
+ *
+ *  A pool of independent emulators, each one owned by a worker thread, used to
+ *  simulate several search nodes at the same time.
+ **************************************************************************** */
+
+#include "EmulatorPool.hpp"
+#include "OSystem.hxx"
+#include "Settings.hxx"
+#include "../ale_interface.hpp"
+
+#include <cstdio>
+
+EmulatorPool::EmulatorPool(OSystem* osystem, int num_workers) :
+		m_job(NULL), m_num_jobs(0), m_next_job(0), m_active_workers(0), m_each_worker(
+				false), m_generation(0), m_stop(false) {
+	// Emulators are built one after the other on this thread: Stella fills
+	// some static tables while constructing a console.
+	for (int i = 0; i < num_workers; ++i) {
+		m_emulators.push_back(create_emulator(osystem));
+	}
+	for (int i = 0; i < num_workers; ++i) {
+		m_threads.push_back(std::thread(&EmulatorPool::worker, this, i));
+	}
+	printf("Emulator pool: %d workers\n", num_workers);
+}
+
+EmulatorPool::~EmulatorPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for (size_t i = 0; i < m_threads.size(); ++i) {
+		m_threads[i].join();
+	}
+	for (size_t i = 0; i < m_emulators.size(); ++i) {
+		delete m_emulators[i];
+	}
+}
+
+// Settings only lets subclasses see its key/value arrays. A pointer to one
+// of them, taken here, can be applied to any Settings object.
+class SettingsCopy: public Settings {
+public:
+	static void copy(const Settings& from, Settings& to) {
+		const SettingsArray Settings::* arrays[] = {
+				&SettingsCopy::myInternalSettings,
+				&SettingsCopy::myExternalSettings };
+		for (int k = 0; k < 2; ++k) {
+			const SettingsArray& settings = from.*arrays[k];
+			for (unsigned i = 0; i < settings.size(); ++i) {
+				to.setString(settings[i].key, settings[i].value);
+			}
+		}
+	}
+};
+
+ALEInterface* EmulatorPool::create_emulator(OSystem* osystem) {
+	ALEInterface* ale = new ALEInterface(false);
+	Settings& settings = ale->theOSystem->settings();
+	SettingsCopy::copy(osystem->settings(), settings);
+	// Only the main emulator shows or records the game
+	settings.setBool("display_screen", false);
+	settings.setString("record_screen_dir", "");
+	ale->loadROM(osystem->romFile());
+	return ale;
+}
+
+StellaEnvironment* EmulatorPool::environment(int i) {
+	return m_emulators[i]->environment.get();
+}
+
+void EmulatorPool::run(size_t num_jobs, const Job& job) {
+	if (num_jobs == 0) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_each_worker = false;
+		m_num_jobs = num_jobs;
+		m_next_job = 0;
+		m_active_workers = m_threads.size();
+		++m_generation;
+	}
+	m_start.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] {return m_active_workers == 0;});
+	m_job = NULL;
+}
+
+void EmulatorPool::run_on_each(const Job& job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_each_worker = true;
+		m_num_jobs = m_threads.size();
+		m_active_workers = m_threads.size();
+		++m_generation;
+	}
+	m_start.notify_all();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] {return m_active_workers == 0;});
+	m_job = NULL;
+}
+
+void EmulatorPool::worker(size_t id) {
+	StellaEnvironment* env = m_emulators[id]->environment.get();
+	unsigned long generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock,
+					[&] {return m_stop || m_generation != generation;});
+			if (m_stop) {
+				return;
+			}
+			generation = m_generation;
+		}
+
+		if (m_each_worker) {
+			(*m_job)(id, env);
+		} else {
+			size_t i;
+			while ((i = m_next_job++) < m_num_jobs) {
+				(*m_job)(i, env);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_active_workers == 0) {
+				m_done.notify_one();
+			}
+		}
+	}
+}
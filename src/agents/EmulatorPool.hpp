@@ -0,0 +1,87 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  EmulatorPool.hpp
+ *
+ *  A pool of independent emulators, each one owned by a worker thread, used to
+ *  simulate several search nodes at the same time.
+ **************************************************************************** */
+
+#ifndef __EMULATOR_POOL_HPP__
+#define __EMULATOR_POOL_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class OSystem;
+class ALEInterface;
+class StellaEnvironment;
+
+class EmulatorPool {
+public:
+	typedef std::function<void(size_t, StellaEnvironment*)> Job;
+
+	/* *********************************************************************
+	 Constructor
+	 Loads the ROM of the given system into num_workers new emulators
+	 and starts one worker thread for each of them.
+	 ******************************************************************* */
+	EmulatorPool(OSystem* osystem, int num_workers);
+
+	/* *********************************************************************
+	 Destructor: stops the workers and frees their emulators.
+	 ******************************************************************* */
+	~EmulatorPool();
+
+	/** Calls job(i, env) for every i in [0, num_jobs) and returns once all
+	 *  calls are done. Calls run concurrently, each one on the emulator of
+	 *  the worker that picked it up, so a job must only touch the data
+	 *  that belongs to index i. */
+	void run(size_t num_jobs, const Job& job);
+
+	/** Calls job(i, env) exactly once on every worker i, with its own
+	 *  emulator, and returns once all calls are done. */
+	void run_on_each(const Job& job);
+
+	int size() const {
+		return m_emulators.size();
+	}
+
+	/** Emulator owned by worker i. Only touch it while the pool is idle. */
+	StellaEnvironment* environment(int i);
+
+	/** New emulator running the ROM of the given system, with all of its
+	 *  settings (frame skip, sticky actions, seed, mode...) so that it steps
+	 *  exactly like it, but no display. Must be called on the main thread. */
+	static ALEInterface* create_emulator(OSystem* osystem);
+
+private:
+	void worker(size_t id);
+
+	std::vector<ALEInterface*> m_emulators;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+
+	const Job* m_job;
+	size_t m_num_jobs;
+	std::atomic<size_t> m_next_job;
+	size_t m_active_workers;
+	bool m_each_worker;
+	unsigned long m_generation;
+	bool m_stop;
+};
+
+#endif // __EMULATOR_POOL_HPP__
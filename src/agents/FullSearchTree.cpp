@@ -203,15 +203,16 @@ void FullSearchTree::expand_tree(TreeNode* start_node) {
 		}
 	
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 		
 	}
     
-	if (q.empty()) std::cout << "Search Space Exhausted!" << std::endl;
+	if (q.empty()) LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 
 	
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
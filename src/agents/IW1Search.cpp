@@ -1,6 +1,7 @@
 #include "IW1Search.hpp"
 #include "SearchAgent.hpp"
 #include <list>
+#include <chrono>
 
 // Features
 #include "features/TFBinary.hpp"
@@ -26,82 +27,93 @@ IW1Search::IW1Search(RomSettings *rom_settings, Settings &settings,
 
 	m_feature = settings.getString("iw1_feature", false);
 
+	// redundant_ram : Add additional redundant features for iw1.
+	//                 Redundant features are generated by f_j(i) = b_i XOR b_{i+j}
+	m_redundant_ram = settings.getInt("iw1_redundant_ram", false);
+
+	m_novelty_feature = create_novelty_feature(rom_settings, settings, actions,
+			_env);
+
+	m_novelty_table.resize(m_novelty_feature->getNumberOfFeatures());
+	m_pruned_nodes = 0;
+}
+
+IW1Search::~IW1Search() {
+	delete m_novelty_feature;
+//	if (!image_based) {
+//		delete m_novelty_feature;
+////		if (m_novelty_boolean_representation) {
+//////			delete m_ram_novelty_table_true;
+//////			delete m_ram_novelty_table_false;
+////		} else
+////			delete m_ram_novelty_table;
+//	} else {
+//		delete m_image_novelty_table;
+//	}
+}
+
+/* *********************************************************************
+ Creates the feature set selected by iw1_feature on the given emulator
+ ******************************************************************* */
+Features* IW1Search::create_novelty_feature(RomSettings *rom_settings,
+		Settings &settings, ActionVect &actions, StellaEnvironment* env) {
+	Features* feature;
 	if (m_feature == "ram_binary") {
-		m_novelty_feature = new TFBinary(_env);
+		feature = new TFBinary(env);
 		printf("IW1 feature: ram_binary\n");
 	} else if (m_feature == "ram_bytes") {
-		m_redundant_ram = settings.getInt("iw1_redundant_ram", false);
 		if (m_redundant_ram >= 1) {
-			m_novelty_feature = new RAMBytes(_env, m_redundant_ram);
+			feature = new RAMBytes(env, m_redundant_ram);
 		} else {
-			m_novelty_feature = new RAMBytes(_env);
+			feature = new RAMBytes(env);
 		}
 		printf("IW1 feature: ram_bytes with redundancy %d\n", m_redundant_ram);
 	} else if (m_feature == "screen_pixel") {
-		m_novelty_feature = new ScreenPixels(_env);
+		feature = new ScreenPixels(env);
 		printf("IW1 feature: screen_pixel\n");
 	} else if (m_feature == "tile") {
-		m_novelty_feature = new BasicFeatures(rom_settings, settings, actions,
-				_env);
+		feature = new BasicFeatures(rom_settings, settings, actions,
+				env);
 		printf("IW1 feature: tile\n");
 	} else if (m_feature == "bpro") {
-		m_novelty_feature = new BPROFeatures(rom_settings, settings, actions,
-				_env);
+		feature = new BPROFeatures(rom_settings, settings, actions,
+				env);
 		printf("IW1 feature: bpro\n");
 	} else {
 		// TODO: Legacy code before refactoring.
 		//       Let's keep it here for the compatibility.
 
-		// redundant_ram : Add additional redundant features for iw1.
-		//                 Redundant features are generated by f_j(i) = b_i XOR b_{i+j}
-		m_redundant_ram = settings.getInt("iw1_redundant_ram", false);
-
 		// TODO: State feature should definately be refactored.
 		//       I'm like 3 days before the deadline so forgive me.
 
 		if (!image_based) {
 			if (m_novelty_boolean_representation) {
-				m_novelty_feature = new TFBinary(_env);
+				feature = new TFBinary(env);
 				//			m_ram_novelty_table_true = new aptk::Bit_Matrix(RAM_SIZE, 8);
 				//			m_ram_novelty_table_false = new aptk::Bit_Matrix(RAM_SIZE, 8);
 			} else {
 				// TODO:
 				if (m_redundant_ram >= 1) {
-					m_novelty_feature = new RAMBytes(_env, m_redundant_ram);
+					feature = new RAMBytes(env, m_redundant_ram);
 					// Add f(X) to RAM. f(b_i, b_{i+1}) = b_i XOR b_{i+1}.
 					//				m_ram_novelty_table = new aptk::Bit_Matrix(
 					//				RAM_SIZE * (1 + m_redundant_ram), 256);
 					printf("IW1: redundant_ram %d\n", m_redundant_ram);
 				} else {
-					m_novelty_feature = new RAMBytes(_env);
+					feature = new RAMBytes(env);
 					//				m_ram_novelty_table = new aptk::Bit_Matrix(RAM_SIZE, 256);
 				}
 			}
 		} else {
-			m_novelty_feature = new ScreenPixels(_env);
-			//		int image_size = _env->getScreen().width() * _env->getScreen().height();
+			feature = new ScreenPixels(env);
+			//		int image_size = env->getScreen().width() * env->getScreen().height();
 			////		printf("image_size = %d\n", image_size);
 			//		m_image_novelty_table = new aptk::Bit_Matrix(image_size,
 			//				256 * sizeof(unsigned char));
 		}
 	}
 
-	m_novelty_table.resize(m_novelty_feature->getNumberOfFeatures());
-	m_pruned_nodes = 0;
-}
-
-IW1Search::~IW1Search() {
-	delete m_novelty_feature;
-//	if (!image_based) {
-//		delete m_novelty_feature;
-////		if (m_novelty_boolean_representation) {
-//////			delete m_ram_novelty_table_true;
-//////			delete m_ram_novelty_table_false;
-////		} else
-////			delete m_ram_novelty_table;
-//	} else {
-//		delete m_image_novelty_table;
-//	}
+	return feature;
 }
 
 /* *********************************************************************
@@ -179,8 +191,7 @@ void IW1Search::update_tree() {
 void IW1Search::update_novelty_table(ALEState& machine_state) {
 //	if (!image_based) {
 	vector<bool> features;
-	m_novelty_feature->getFeatures(get_screen(machine_state),
-			machine_state.getRAM(), features);
+	get_novelty_features(machine_state, features);
 	for (int i = 0; i < features.size(); ++i) {
 		if (features[i]) {
 			m_novelty_table[i] = true;
@@ -228,8 +239,7 @@ void IW1Search::update_novelty_table(ALEState& machine_state) {
 bool IW1Search::check_novelty_1(ALEState& machine_state) {
 //	if (!image_based) {
 	vector<bool> features;
-	m_novelty_feature->getFeatures(get_screen(machine_state),
-			machine_state.getRAM(), features);
+	get_novelty_features(machine_state, features);
 	for (int i = 0; i < features.size(); ++i) {
 		// If a feature is true in the new state but not in the novelty table,
 		// it means that the state has a new feature.
@@ -290,11 +300,35 @@ bool IW1Search::check_novelty_1(ALEState& machine_state) {
 // ILL ADVISED HACKING:
 // This is just to make sure that Screen is initialized.
 const ALEScreen IW1Search::get_screen(ALEState &machine_state) {
-	ALEState buffer = m_env->cloneState();
-	m_env->restoreState(machine_state);
-	const ALEScreen screen = m_env->buildAndGetScreen();
-	m_env->restoreState(buffer);
-	return screen;
+	// Every simulation restores its own start state, so m_env does not
+	// need to be put back; usually it already holds the child just simulated
+	load_state(m_env, machine_state);
+	return m_env->buildAndGetScreen();
+}
+
+// RAM features never look at the screen, so the state is neither restored
+// nor rendered for them.
+void IW1Search::get_novelty_features(ALEState& machine_state,
+		vector<bool>& features) {
+	TRACE_SPAN("getFeatures");
+	PerfSample perf_start;
+	if (m_perf_sections)
+		m_perf->read(perf_start);
+	auto start = std::chrono::high_resolution_clock::now();
+	if (m_novelty_feature->usesScreen())
+		m_novelty_feature->getFeatures(get_screen(machine_state),
+				machine_state.getRAM(), features);
+	else
+		m_novelty_feature->getFeatures(m_env->getScreen(),
+				machine_state.getRAM(), features);
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_feature_time += std::chrono::duration_cast<std::chrono::microseconds>(
+			elapsed).count();
+	if (m_perf_sections) {
+		PerfSample perf_end;
+		m_perf->read(perf_end);
+		m_feature_counters.add_delta(perf_start, perf_end);
+	}
 }
 
 int IW1Search::expand_node(TreeNode* curr_node, queue<TreeNode*>& q) {
@@ -334,6 +368,26 @@ int IW1Search::expand_node(TreeNode* curr_node, queue<TreeNode*>& q) {
 		}
 	}
 
+	// Create the children of a leaf up front and simulate them together
+	// (on the emulator pool if there is one). They are attached to the tree
+	// one by one below, in action order, as if simulated right there.
+	NodeList generated;
+	if (leaf_node) {
+		generated.resize(num_actions);
+		for (int a = 0; a < num_actions; a++) {
+			Action act = curr_node->available_actions[a];
+			if (action_sequence_detection && curr_node != p_root
+					&& !isUsefulAction[act]) {
+				generated[a] = new TreeNode(curr_node, curr_node->state, this,
+						act, 0);
+			} else {
+				generated[a] = prepare_child(curr_node, act,
+						sim_steps_per_node);
+			}
+		}
+		simulate_children();
+	}
+
 	for (int a = 0; a < num_actions; a++) {
 		Action act = curr_node->available_actions[a];
 
@@ -348,9 +402,7 @@ int IW1Search::expand_node(TreeNode* curr_node, queue<TreeNode*>& q) {
 						//					printf("Pruned %d\n", (int) a,
 						//							action_to_string((Action) a).c_str());
 						// TODO: generate dummy node
-						TreeNode * child;
-						child = new TreeNode(curr_node, curr_node->state, this,
-								act, 0);
+						TreeNode * child = generated[a];
 						curr_node->v_children[a] = child;
 						child->is_terminal = true;
 						continue;
@@ -359,8 +411,7 @@ int IW1Search::expand_node(TreeNode* curr_node, queue<TreeNode*>& q) {
 			}
 
 			m_generated_nodes++;
-			child = new TreeNode(curr_node, curr_node->state, this, act,
-					sim_steps_per_node);
+			child = generated[a];
 
 			if (check_novelty_1(child->state)) {
 				update_novelty_table(child->state);
@@ -447,14 +498,14 @@ void IW1Search::expand_tree(TreeNode* start_node) {
 
 	do {
 
-		std::cout << "# Pivots: " << pivots.size() << std::endl;
-		std::cout << "First pivot reward: " << pivots.front()->node_reward
-				<< std::endl;
+		LOG(LOG_TRACE, "# Pivots: %zu\n", pivots.size());
+		LOG(LOG_TRACE, "First pivot reward: %g\n",
+				(double) pivots.front()->node_reward);
 		pivots.front()->m_depth = 0;
 		int steps = expand_node(pivots.front(), q);
 		num_simulated_steps += steps;
 
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
@@ -474,25 +525,26 @@ void IW1Search::expand_tree(TreeNode* start_node) {
 			steps = expand_node(curr_node, q);
 			num_simulated_steps += steps;
 			// Stop once we have simulated a maximum number of steps
-			if (num_simulated_steps >= max_sim_steps_per_frame) {
+			if (budget_spent(num_simulated_steps)) {
 				break;
 			}
 
 		}
-		std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-		std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-		std::cout << "\tGenerated so far: " << m_generated_nodes << std::endl;
+		LOG(LOG_TRACE, "\tExpanded so far: %u\n", m_expanded_nodes);
+		LOG(LOG_TRACE, "\tPruned so far: %u\n", m_pruned_nodes);
+		LOG(LOG_TRACE, "\tGenerated so far: %u\n", m_generated_nodes);
 //		std::cout << "\tSimulated steps: " << num_simulated_steps
 
 		if (q.empty())
-			std::cout << "Search Space Exhausted!" << std::endl;
+			LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	} while (!pivots.empty());
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -640,6 +692,7 @@ void IW1Search::print_frame_data(int frame_number, float elapsed,
 	output << ",elapsed=" << elapsed;
 	output << ",total_simulation_steps=" << m_total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
+	print_profile_data(output);
 	m_rom_settings->print(output);
 	output << std::endl;
 }
@@ -56,11 +56,23 @@ protected:
 	bool check_novelty_1(ALEState &machine_state);
 
 	const ALEScreen get_screen(ALEState &machine_state);
+	/** Novelty features of a state; renders it only if they need pixels */
+	void get_novelty_features(ALEState& machine_state,
+			vector<bool>& features);
+
+	/** Creates the feature set selected by iw1_feature on an emulator */
+	Features* create_novelty_feature(RomSettings *rom_settings,
+			Settings &settings, ActionVect &actions, StellaEnvironment* env);
 
 	virtual void clear();
 	virtual void move_to_best_sub_branch();
 	virtual void move_to_branch(Action a, int duration);
 
+	virtual size_t novelty_bytes() const {
+		// vector<bool> packs its bits in whole words
+		return m_novelty_table.capacity() / 8;
+	}
+
 	ALERAM m_ram;
 	Features* m_novelty_feature;
 	vector<bool> m_novelty_table;
@@ -0,0 +1,157 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Logger.cpp
+ *
+ *  Leveled logger of the search output, on a bounded lock-free queue
+ *  (Vyukov's multi-producer ring) drained by a single writer thread.
+ **************************************************************************** */
+
+#include "Logger.hpp"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+
+int Logger::s_level = LOG_INFO;
+
+// A slot belongs to a producer when sequence equals the position it
+// claimed, and to the writer when sequence equals that position plus one
+struct LogSlot {
+	std::atomic<size_t> sequence;
+	LogLevel level;
+	int length;
+	char text[1024];
+};
+
+class LogQueue {
+public:
+	static const size_t num_slots = 1024; // a power of two
+
+	LogQueue() :
+			m_enqueued(0), m_dequeued(0), m_written(0), m_stop(false) {
+		for (size_t i = 0; i < num_slots; ++i) {
+			m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		m_thread = std::thread(&LogQueue::run, this);
+	}
+
+	~LogQueue() {
+		m_stop = true;
+		m_thread.join();
+	}
+
+	void push(LogLevel level, const char* format, va_list args) {
+		size_t pos = m_enqueued.load(std::memory_order_relaxed);
+		LogSlot* slot;
+		while (true) {
+			slot = &m_slots[pos & (num_slots - 1)];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			long diff = (long) sequence - (long) pos;
+			if (diff == 0) {
+				if (m_enqueued.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				// Full: wait for the writer rather than lose the message
+				std::this_thread::yield();
+				pos = m_enqueued.load(std::memory_order_relaxed);
+			} else {
+				pos = m_enqueued.load(std::memory_order_relaxed);
+			}
+		}
+
+		int length = vsnprintf(slot->text, sizeof(slot->text), format, args);
+		if (length < 0)
+			length = 0;
+		else if (length >= (int) sizeof(slot->text))
+			length = sizeof(slot->text) - 1;
+		slot->level = level;
+		slot->length = length;
+		slot->sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	void flush() {
+		size_t target = m_enqueued.load(std::memory_order_acquire);
+		while (m_written.load(std::memory_order_acquire) < target) {
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	// Writes one message; returns false if the queue is empty
+	bool pop() {
+		LogSlot& slot = m_slots[m_dequeued & (num_slots - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != m_dequeued + 1)
+			return false;
+		FILE* stream = (slot.level <= LOG_WARN ? stderr : stdout);
+		fwrite(slot.text, 1, slot.length, stream);
+		slot.sequence.store(m_dequeued + num_slots, std::memory_order_release);
+		m_dequeued++;
+		return true;
+	}
+
+	void run() {
+		while (true) {
+			bool wrote = false;
+			while (pop())
+				wrote = true;
+			if (wrote) {
+				fflush(stdout);
+				m_written.store(m_dequeued, std::memory_order_release);
+			} else if (m_stop) {
+				return;
+			} else {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+		}
+	}
+
+	LogSlot m_slots[num_slots];
+	std::atomic<size_t> m_enqueued;
+	size_t m_dequeued; // only touched by the writer
+	std::atomic<size_t> m_written;
+	std::atomic<bool> m_stop;
+	std::thread m_thread;
+};
+
+static std::atomic<bool> g_queue_created(false);
+
+// Created on the first message, so that runs at the default level never
+// start the writer thread
+static LogQueue* queue() {
+	static LogQueue queue;
+	g_queue_created = true;
+	return &queue;
+}
+
+bool Logger::set_level(const std::string& name) {
+	static const char* names[] = { "error", "warn", "info", "debug", "trace" };
+	for (int i = LOG_ERROR; i <= LOG_TRACE; ++i) {
+		if (name == names[i]) {
+			s_level = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Logger::log(LogLevel level, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	queue()->push(level, format, args);
+	va_end(args);
+}
+
+void Logger::flush() {
+	if (g_queue_created)
+		queue()->flush();
+}
@@ -0,0 +1,62 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Logger.hpp
+ *
+ *  Leveled logger of the search output. LOG(level, format, ...) formats a
+ *  printf-style message only if level is enabled (see -log_level), straight
+ *  into a slot of a lock-free queue. A background thread writes the queued
+ *  messages to stdout, so the search never waits on the terminal.
+ **************************************************************************** */
+
+#ifndef __LOGGER_HPP__
+#define __LOGGER_HPP__
+
+#include <string>
+
+enum LogLevel {
+	LOG_ERROR = 0,
+	LOG_WARN,
+	LOG_INFO, // configuration and rare events (default)
+	LOG_DEBUG, // a few lines per decision
+	LOG_TRACE // lines from inside the search loops
+};
+
+class Logger {
+public:
+	static bool enabled(LogLevel level) {
+		return level <= s_level;
+	}
+
+	static void set_level(LogLevel level) {
+		s_level = level;
+	}
+	/** Sets the level from its name (error, warn, info, debug or trace);
+	 *  returns false and keeps the level if the name is unknown */
+	static bool set_level(const std::string& name);
+
+	/** Queues a message; it is written as is, add the newline. Messages
+	 *  are cut at 1023 characters. Blocks while the queue is full. */
+	static void log(LogLevel level, const char* format, ...)
+			__attribute__((format(printf, 2, 3)));
+
+	/** Waits until every message queued so far is on stdout */
+	static void flush();
+
+private:
+	static int s_level;
+};
+
+#define LOG(level, ...) \
+	do { \
+		if (Logger::enabled(level)) \
+			Logger::log(level, __VA_ARGS__); \
+	} while (0)
+
+#endif // __LOGGER_HPP__
@@ -1,6 +1,7 @@
 #include "PIW1Search.hpp"
 #include "SearchAgent.hpp"
 #include <list>
+#include <chrono>
 
 #include "DominatedActionSequenceDetection.hpp"
 // Features
@@ -211,8 +212,7 @@ void PIW1Search::update_novelty_table(ALEState& machine_state,
 //	bool updated = false;
 
 	vector<bool> features;
-	m_novelty_feature->getFeatures(get_screen(machine_state),
-			machine_state.getRAM(), features);
+	get_novelty_features(machine_state, features);
 	for (int i = 0; i < features.size(); ++i) {
 		if (features[i]) {
 			if (accumulated_reward > m_novelty_table[i]) {
@@ -277,8 +277,7 @@ void PIW1Search::update_novelty_table(ALEState& machine_state,
 bool PIW1Search::check_novelty_1(ALEState& machine_state,
 		reward_t accumulated_reward) {
 	vector<bool> features;
-	m_novelty_feature->getFeatures(get_screen(machine_state),
-			machine_state.getRAM(), features);
+	get_novelty_features(machine_state, features);
 	for (int i = 0; i < features.size(); ++i) {
 		// If a feature is true in the new state but not in the novelty table,
 		// it means that the state has a new feature.
@@ -361,8 +360,7 @@ int PIW1Search::check_novelty(ALEState& machine_state,
 		reward_t accumulated_reward) {
 	int novelty = 0;
 	vector<bool> features;
-	m_novelty_feature->getFeatures(get_screen(machine_state),
-			machine_state.getRAM(), features);
+	get_novelty_features(machine_state, features);
 	for (int i = 0; i < features.size(); ++i) {
 		// If a feature is true in the new state but not in the novelty table,
 		// it means that the state has a new feature.
@@ -440,6 +438,26 @@ int PIW1Search::expand_node(TreeNode* curr_node) {
 		}
 	}
 
+	// Create the children of a leaf up front and simulate them together
+	// (on the emulator pool if there is one). They are attached to the tree
+	// one by one below, in action order, as if simulated right there.
+	NodeList generated;
+	if (leaf_node) {
+		generated.resize(num_actions);
+		for (int a = 0; a < num_actions; a++) {
+			Action act = curr_node->available_actions[a];
+			if (action_sequence_detection && curr_node != p_root
+					&& !isUsefulAction[act]) {
+				generated[a] = new TreeNode(curr_node, curr_node->state, this,
+						act, 0);
+			} else {
+				generated[a] = prepare_child(curr_node, act,
+						sim_steps_per_node);
+			}
+		}
+		simulate_children();
+	}
+
 	for (int a = 0; a < num_actions; a++) {
 		Action act = curr_node->available_actions[a];
 
@@ -451,8 +469,7 @@ int PIW1Search::expand_node(TreeNode* curr_node) {
 				if (curr_node != p_root) {
 					if (!isUsefulAction[act]) {
 						m_jasd_pruned_nodes++;
-						TreeNode * child = new TreeNode(curr_node,
-								curr_node->state, this, act, 0);
+						TreeNode * child = generated[a];
 						curr_node->v_children[a] = child;
 						child->is_terminal = true;
 						continue;
@@ -462,8 +479,7 @@ int PIW1Search::expand_node(TreeNode* curr_node) {
 
 			m_generated_nodes++;
 
-			child = new TreeNode(curr_node, curr_node->state, this, act,
-					sim_steps_per_node);
+			child = generated[a];
 
 			// Pruning is executed when the node is generated.
 			if (check_novelty_1(child->state, child->accumulated_reward)) {
@@ -609,14 +625,14 @@ void PIW1Search::expand_tree(TreeNode* start_node) {
 
 	do {
 
-		std::cout << "# Pivots: " << pivots.size() << std::endl;
-		std::cout << "First pivot reward: " << pivots.front()->node_reward
-				<< std::endl;
+		LOG(LOG_TRACE, "# Pivots: %zu\n", pivots.size());
+		LOG(LOG_TRACE, "First pivot reward: %g\n",
+				(double) pivots.front()->node_reward);
 		pivots.front()->m_depth = 0;
 		int steps = expand_node(pivots.front());
 		num_simulated_steps += steps;
 
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
@@ -638,18 +654,17 @@ void PIW1Search::expand_tree(TreeNode* start_node) {
 				steps = expand_node(curr_node);
 				num_simulated_steps += steps;
 				// Stop once we have simulated a maximum number of steps
-				if (num_simulated_steps >= max_sim_steps_per_frame) {
+				if (budget_spent(num_simulated_steps)) {
 					break;
 				}
 
 			}
-			std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-			std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-			std::cout << "\tGenerated so far: " << m_generated_nodes
-					<< std::endl;
+			LOG(LOG_TRACE, "\tExpanded so far: %u\n", m_expanded_nodes);
+			LOG(LOG_TRACE, "\tPruned so far: %u\n", m_pruned_nodes);
+			LOG(LOG_TRACE, "\tGenerated so far: %u\n", m_generated_nodes);
 
 			if (m_q_reward.empty())
-				std::cout << "Search Space Exhausted!" << std::endl;
+				LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 		} else if (m_priority_queue == "novelty") {
 			while (!m_q_novelty.empty()) {
 				// Pop a node to expand
@@ -665,30 +680,30 @@ void PIW1Search::expand_tree(TreeNode* start_node) {
 				steps = expand_node(curr_node);
 				num_simulated_steps += steps;
 				// Stop once we have simulated a maximum number of steps
-				if (num_simulated_steps >= max_sim_steps_per_frame) {
+				if (budget_spent(num_simulated_steps)) {
 					break;
 				}
 
 			}
-			std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-			std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-			std::cout << "\tGenerated so far: " << m_generated_nodes
-					<< std::endl;
+			LOG(LOG_TRACE, "\tExpanded so far: %u\n", m_expanded_nodes);
+			LOG(LOG_TRACE, "\tPruned so far: %u\n", m_pruned_nodes);
+			LOG(LOG_TRACE, "\tGenerated so far: %u\n", m_generated_nodes);
 
 			if (m_q_novelty.empty())
-				std::cout << "Search Space Exhausted!" << std::endl;
+				LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 		} else {
 			printf("undefined priority queue error: %s\n",
 					m_priority_queue.c_str());
 		}
 
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	} while (!pivots.empty());
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -876,11 +891,35 @@ bool PIW1Search::test_duplicate_reward(TreeNode * node) {
 }
 
 const ALEScreen PIW1Search::get_screen(ALEState &machine_state) {
-	ALEState buffer = m_env->cloneState();
-	m_env->restoreState(machine_state);
-	const ALEScreen screen = m_env->buildAndGetScreen();
-	m_env->restoreState(buffer);
-	return screen;
+	// Every simulation restores its own start state, so m_env does not
+	// need to be put back; usually it already holds the child just simulated
+	load_state(m_env, machine_state);
+	return m_env->buildAndGetScreen();
+}
+
+// RAM features never look at the screen, so the state is neither restored
+// nor rendered for them.
+void PIW1Search::get_novelty_features(ALEState& machine_state,
+		vector<bool>& features) {
+	TRACE_SPAN("getFeatures");
+	PerfSample perf_start;
+	if (m_perf_sections)
+		m_perf->read(perf_start);
+	auto start = std::chrono::high_resolution_clock::now();
+	if (m_novelty_feature->usesScreen())
+		m_novelty_feature->getFeatures(get_screen(machine_state),
+				machine_state.getRAM(), features);
+	else
+		m_novelty_feature->getFeatures(m_env->getScreen(),
+				machine_state.getRAM(), features);
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_feature_time += std::chrono::duration_cast<std::chrono::microseconds>(
+			elapsed).count();
+	if (m_perf_sections) {
+		PerfSample perf_end;
+		m_perf->read(perf_end);
+		m_feature_counters.add_delta(perf_start, perf_end);
+	}
 }
 
 void PIW1Search::print_frame_data(int frame_number, float elapsed,
@@ -897,6 +936,7 @@ void PIW1Search::print_frame_data(int frame_number, float elapsed,
 	output << ",elapsed=" << elapsed;
 	output << ",total_simulation_steps=" << total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
+	print_profile_data(output);
 	m_rom_settings->print(output);
 	output << std::endl;
 }
@@ -108,7 +108,14 @@ protected:
 	virtual void move_to_branch(Action a, int duration);
 	bool test_duplicate_reward(TreeNode * node);
 
+	virtual size_t novelty_bytes() const {
+		return m_novelty_table.capacity() * sizeof(int);
+	}
+
 	const ALEScreen get_screen(ALEState &machine_state);
+	/** Novelty features of a state; renders it only if they need pixels */
+	void get_novelty_features(ALEState& machine_state,
+			vector<bool>& features);
 
 
 	std::priority_queue<TreeNode*, std::vector<TreeNode*>,
@@ -0,0 +1,369 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ParallelIW1Search.cpp
+ *
+ *  Breadth-first IW(1) and p-IW(1) run by all the workers of the emulator
+ *  pool at once. Each worker expands nodes on its own emulator, takes work
+ *  from a work-stealing frontier and prunes against a lock-free novelty
+ *  table shared by everybody.
+ **************************************************************************** */
+
+#include "ParallelIW1Search.hpp"
+#include "EmulatorPool.hpp"
+
+#include <chrono>
+#include <thread>
+
+ParallelIW1Search::ParallelIW1Search(RomSettings *rom_settings,
+		Settings &settings, ActionVect &actions, StellaEnvironment* _env,
+		bool reward_novelty) :
+		IW1Search(rom_settings, settings, actions, _env), m_reward_novelty(
+				reward_novelty), m_settings(settings), m_simulated_steps(0), m_outstanding(
+				0), m_budget_spent(false), m_expansion_time(0), m_steals(0) {
+	m_shared_novelty.resize(m_novelty_feature->getNumberOfFeatures(),
+			!m_reward_novelty);
+	printf("Parallel %s\n", m_reward_novelty ? "p-IW(1)" : "IW(1)");
+}
+
+ParallelIW1Search::~ParallelIW1Search() {
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		if (m_workers[i]->feature != m_novelty_feature) {
+			delete m_workers[i]->feature;
+		}
+		delete m_workers[i];
+	}
+}
+
+void ParallelIW1Search::create_workers() {
+	int num_workers = (m_emulator_pool != NULL ? m_emulator_pool->size() : 1);
+	for (int i = 0; i < num_workers; ++i) {
+		Worker* w = new Worker();
+		if (m_emulator_pool != NULL) {
+			// Features may keep state between calls (e.g. BPROFeatures),
+			// so every worker needs its own instance.
+			w->env = m_emulator_pool->environment(i);
+			w->feature = create_novelty_feature(m_rom_settings, m_settings,
+					available_actions, w->env);
+		} else {
+			w->env = m_env;
+			w->feature = m_novelty_feature;
+		}
+		w->rng.seed(rand());
+		m_workers.push_back(w);
+	}
+}
+
+void ParallelIW1Search::expand_tree(TreeNode* start_node) {
+	if (m_workers.empty()) {
+		create_workers();
+	}
+
+	if (!start_node->v_children.empty()) {
+		start_node->updateTreeNode();
+		for (int a = 0; a < available_actions.size(); a++) {
+			TreeNode* child = start_node->v_children[a];
+			if (!child->is_terminal) {
+				child->num_nodes_reusable = child->num_nodes();
+			}
+		}
+	}
+
+	// The root's features are marked on the main emulator, as in IW1Search
+	m_shared_novelty.clear();
+	vector<bool> features;
+	get_novelty_features(start_node->state, features);
+	for (size_t i = 0; i < features.size(); ++i) {
+		if (features[i]) {
+			if (m_reward_novelty)
+				m_shared_novelty.raise(i, 0);
+			else
+				m_shared_novelty.test_and_set(i);
+		}
+	}
+
+	m_expanded_nodes = 0;
+	m_generated_nodes = 0;
+	m_pruned_nodes = 0;
+	m_jasd_pruned_nodes = 0;
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		Worker* w = m_workers[i];
+		w->expanded_nodes = 0;
+		w->generated_nodes = 0;
+		w->pruned_nodes = 0;
+		w->max_depth = 0;
+		w->simulation_steps = 0;
+		w->context_time = 0;
+		w->emulation_time = 0;
+	}
+	m_simulated_steps = 0;
+	m_budget_spent = false;
+	m_steals = 0;
+	m_pivots.clear();
+	m_pivots.push_back(start_node);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	while (!m_pivots.empty() && !m_budget_spent) {
+		LOG(LOG_TRACE, "# Pivots: %zu\n", m_pivots.size());
+		LOG(LOG_TRACE, "First pivot reward: %g\n",
+				(double) m_pivots.front()->node_reward);
+		TreeNode* pivot = m_pivots.front();
+		m_pivots.pop_front();
+		pivot->m_depth = 0;
+
+		// The pivot is always expanded, whatever its reward. The pool is idle
+		// at this point, so the first worker's emulator is free to use.
+		m_outstanding = 0;
+		expand_parallel(0, pivot);
+		if (m_budget_spent) {
+			break;
+		}
+
+		if (m_emulator_pool != NULL) {
+			m_emulator_pool->run_on_each(
+					[this](size_t i, StellaEnvironment* env) {
+						run_worker(i);
+					});
+		} else {
+			run_worker(0);
+		}
+	}
+
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_expansion_time += std::chrono::duration_cast<std::chrono::microseconds>(
+			elapsed).count();
+
+	// Whatever is left on the frontiers is not expanded on this decision
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		Worker* w = m_workers[i];
+		w->frontier.clear();
+
+		m_expanded_nodes += w->expanded_nodes;
+		m_generated_nodes += w->generated_nodes;
+		m_pruned_nodes += w->pruned_nodes;
+		if (w->max_depth > m_max_depth)
+			m_max_depth = w->max_depth;
+		m_total_simulation_steps += w->simulation_steps;
+		m_context_time += w->context_time;
+		m_emulation_time += w->emulation_time;
+	}
+	LOG(LOG_DEBUG, "\tExpanded so far: %u\n", m_expanded_nodes);
+	LOG(LOG_DEBUG, "\tPruned so far: %u\n", m_pruned_nodes);
+	LOG(LOG_DEBUG, "\tGenerated so far: %u\n", m_generated_nodes);
+	LOG(LOG_DEBUG, "\tSteals: %u\n", m_steals.load());
+
+	TRACE_SPAN("update_branch_return");
+	update_branch_return(start_node);
+}
+
+void ParallelIW1Search::run_worker(size_t id) {
+	while (!m_budget_spent) {
+		TreeNode* node = next_node(id);
+		if (node == NULL) {
+			// Other workers may still push the children of what they hold
+			if (m_outstanding == 0) {
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (node->depth() > m_reward_horizon - 1) {
+			// Beyond the horizon: not expanded
+		} else if (m_stop_on_first_reward && node->node_reward != 0) {
+			std::lock_guard<std::mutex> lock(m_pivot_mutex);
+			m_pivots.push_back(node);
+		} else {
+			expand_parallel(id, node);
+		}
+		--m_outstanding;
+	}
+}
+
+TreeNode* ParallelIW1Search::next_node(size_t id) {
+	TreeNode* node = NULL;
+	{
+		Worker& w = *m_workers[id];
+		std::lock_guard<std::mutex> lock(w.frontier_mutex);
+		if (!w.frontier.empty()) {
+			node = w.frontier.front();
+			w.frontier.pop_front();
+			return node;
+		}
+	}
+
+	// Steal the most recent node of another worker, leaving the shallow
+	// ones to their owner so that the expansion stays close to breadth-first
+	for (size_t k = 1; k < m_workers.size(); ++k) {
+		Worker& victim = *m_workers[(id + k) % m_workers.size()];
+		std::lock_guard<std::mutex> lock(victim.frontier_mutex);
+		if (!victim.frontier.empty()) {
+			node = victim.frontier.back();
+			victim.frontier.pop_back();
+			++m_steals;
+			return node;
+		}
+	}
+	return NULL;
+}
+
+void ParallelIW1Search::push_node(size_t id, TreeNode* node) {
+	Worker& w = *m_workers[id];
+	++m_outstanding;
+	std::lock_guard<std::mutex> lock(w.frontier_mutex);
+	w.frontier.push_back(node);
+}
+
+/* *********************************************************************
+ Same expansion as IW1Search::expand_node, run on the worker's own
+ emulator. Dominated action sequence detection and erroneous predictions
+ are not supported here: both draw from shared state.
+ ******************************************************************* */
+int ParallelIW1Search::expand_parallel(size_t id, TreeNode* curr_node) {
+	Worker& w = *m_workers[id];
+	int num_simulated_steps = 0;
+	int num_actions = available_actions.size();
+	bool leaf_node = (curr_node->v_children.empty());
+	unsigned max_nodes_per_frame = max_sim_steps_per_frame
+			/ sim_steps_per_node;
+	w.expanded_nodes++;
+
+	if (leaf_node) {
+		curr_node->v_children.resize(num_actions);
+		curr_node->available_actions = available_actions;
+		if (m_randomize_successor)
+			std::shuffle(curr_node->available_actions.begin(),
+					curr_node->available_actions.end(), w.rng);
+	}
+
+	for (int a = 0; a < num_actions; a++) {
+		Action act = curr_node->available_actions[a];
+
+		TreeNode * child;
+
+		// If re-expanding an internal node, don't creates new nodes
+		if (leaf_node) {
+			w.generated_nodes++;
+			child = new TreeNode(curr_node, curr_node->state, NULL, act,
+					sim_steps_per_node);
+
+			return_t step_return;
+			reward_t first_reward;
+			int steps = simulate_on(w.env, child->state, act,
+					sim_steps_per_node, step_return, first_reward,
+					child->is_terminal, false, true, w.context_time,
+					w.emulation_time);
+			if (normalize_rewards) {
+				std::lock_guard<std::mutex> lock(m_normalize_mutex);
+				step_return = normalize_return(step_return, first_reward);
+			}
+			child->init(steps, step_return);
+			child->accumulate_reward();
+			w.simulation_steps += steps;
+
+			if (!test_and_set_novelty(w, child->state,
+					child->accumulated_reward)) {
+				child->is_terminal = true;
+				w.pruned_nodes++;
+			}
+			if (child->depth() > w.max_depth)
+				w.max_depth = child->depth();
+			num_simulated_steps += steps;
+
+			curr_node->v_children[a] = child;
+		} else {
+			child = curr_node->v_children[a];
+
+			// This recreates the novelty table (which gets resetted every time
+			// we change the root of the search tree)
+			if (m_novelty_pruning) {
+				if (child->is_terminal) {
+					if (test_and_set_novelty(w, child->state,
+							child->accumulated_reward)) {
+						child->is_terminal = false;
+					} else {
+						w.pruned_nodes++;
+					}
+				}
+			}
+			child->updateTreeNode();
+
+			if (child->depth() > w.max_depth)
+				w.max_depth = child->depth();
+		}
+
+		// Don't expand duplicate nodes, or terminal nodes
+		if (!child->is_terminal) {
+			if (!(ignore_duplicates && test_duplicate(child)))
+				if (child->num_nodes_reusable < max_nodes_per_frame)
+					push_node(id, child);
+		}
+	}
+
+	// Global budget over all the workers
+	if (budget_spent(m_simulated_steps += num_simulated_steps))
+		m_budget_spent = true;
+
+	return num_simulated_steps;
+}
+
+bool ParallelIW1Search::test_and_set_novelty(Worker& w, ALEState& state,
+		reward_t accumulated_reward) {
+	// Same as IW1Search::get_novelty_features, but on the worker's emulator
+	w.features.clear();
+	{
+		TRACE_SPAN("getFeatures");
+		if (w.feature->usesScreen()) {
+			load_state(w.env, state);
+			const ALEScreen screen = w.env->buildAndGetScreen();
+			w.feature->getFeatures(screen, state.getRAM(), w.features);
+		} else {
+			w.feature->getFeatures(w.env->getScreen(), state.getRAM(),
+					w.features);
+		}
+	}
+
+	// Every active feature is marked, so concurrent workers racing on the
+	// same feature agree on a single winner.
+	bool novel = false;
+	for (size_t i = 0; i < w.features.size(); ++i) {
+		if (!w.features[i])
+			continue;
+		if (m_reward_novelty) {
+			if (m_shared_novelty.raise(i, accumulated_reward))
+				novel = true;
+		} else {
+			if (m_shared_novelty.test_and_set(i))
+				novel = true;
+		}
+	}
+	return novel;
+}
+
+void ParallelIW1Search::print_frame_data(int frame_number, float elapsed,
+		Action curr_action, std::ostream& output) {
+	output << "frame=" << frame_number;
+	output << ",expanded=" << expanded_nodes();
+	output << ",generated=" << generated_nodes();
+	output << ",pruned=" << pruned();
+	output << ",depth_tree=" << max_depth();
+	output << ",tree_size=" << num_nodes();
+	output << ",best_action=" << action_to_string(curr_action);
+	output << ",branch_reward=" << get_root_value();
+	output << ",elapsed=" << elapsed;
+	output << ",total_simulation_steps=" << m_total_simulation_steps;
+	output << ",emulation_time=" << m_emulation_time;
+	output << ",threads=" << m_workers.size();
+	output << ",steals=" << m_steals;
+	output << ",parallel_expansion_time=" << m_expansion_time;
+	print_profile_data(output);
+	m_rom_settings->print(output);
+	output << std::endl;
+}
@@ -0,0 +1,111 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ParallelIW1Search.hpp
+ *
+ *  Breadth-first IW(1) and p-IW(1) run by all the workers of the emulator
+ *  pool at once. Each worker expands nodes on its own emulator, takes work
+ *  from a work-stealing frontier and prunes against a lock-free novelty
+ *  table shared by everybody.
+ **************************************************************************** */
+
+#ifndef __PARALLEL_IW1_SEARCH_HPP__
+#define __PARALLEL_IW1_SEARCH_HPP__
+
+#include "IW1Search.hpp"
+#include "ConcurrentNoveltyTable.hpp"
+
+#include <deque>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <random>
+
+class ParallelIW1Search: public IW1Search {
+public:
+	/** reward_novelty selects p-IW(1): a feature is novel when it is
+	 *  reached with a higher accumulated reward than before */
+	ParallelIW1Search(RomSettings *, Settings &settings, ActionVect &actions,
+			StellaEnvironment* _env, bool reward_novelty);
+
+	virtual ~ParallelIW1Search();
+
+	virtual void print_frame_data(int frame_number, float elapsed,
+			Action curr_action, std::ostream& output);
+
+protected:
+	// State owned by one worker thread
+	struct Worker {
+		StellaEnvironment* env;
+		Features* feature;
+		std::deque<TreeNode*> frontier;
+		std::mutex frontier_mutex;
+		std::mt19937 rng;
+		vector<bool> features;
+
+		unsigned expanded_nodes;
+		unsigned generated_nodes;
+		unsigned pruned_nodes;
+		unsigned max_depth;
+		unsigned simulation_steps;
+		long long context_time;
+		long long emulation_time;
+	};
+
+	virtual void expand_tree(TreeNode* start);
+
+	/** Creates one Worker per emulator of the pool (or a single one on
+	 *  m_env when there is no pool) */
+	void create_workers();
+
+	/** Worker loop: expands nodes until the frontier is drained or the
+	 *  budget is spent */
+	void run_worker(size_t id);
+
+	/** Pops from the worker's own frontier, or steals from another one */
+	TreeNode* next_node(size_t id);
+	void push_node(size_t id, TreeNode* node);
+
+	/** Expands a node on the worker's emulator; returns simulated steps */
+	int expand_parallel(size_t id, TreeNode* node);
+
+	/** Marks the features of a state in the shared table. Returns true if
+	 *  at least one of them was novel. */
+	bool test_and_set_novelty(Worker& w, ALEState& state,
+			reward_t accumulated_reward);
+
+	virtual size_t novelty_bytes() const {
+		return IW1Search::novelty_bytes() + m_shared_novelty.bytes();
+	}
+
+	bool m_reward_novelty;
+	Settings& m_settings;
+
+	std::vector<Worker*> m_workers;
+	ConcurrentNoveltyTable m_shared_novelty;
+
+	// Simulation steps spent on this decision by all workers together
+	std::atomic<int> m_simulated_steps;
+	// Nodes pushed to a frontier and not yet fully processed
+	std::atomic<int> m_outstanding;
+	std::atomic<bool> m_budget_spent;
+
+	std::mutex m_pivot_mutex;
+	std::list<TreeNode*> m_pivots;
+
+	// Guards reward_magnitude when normalize_rewards is set
+	std::mutex m_normalize_mutex;
+
+	// Wall-clock microseconds spent in parallel expansion
+	long long m_expansion_time;
+	// Nodes taken from another worker's frontier on this decision
+	std::atomic<unsigned> m_steals;
+};
+
+#endif // __PARALLEL_IW1_SEARCH_HPP__
@@ -0,0 +1,131 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  PerfCounters.cpp
+ *
+ *  Hardware performance counters of the calling thread, through
+ *  perf_event_open(2).
+ **************************************************************************** */
+
+#include "PerfCounters.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+const char* PerfCounters::event_name(int event) {
+	static const char* names[] = { "cycles", "instructions", "l1d_misses",
+			"llc_misses", "branch_misses" };
+	return names[event];
+}
+
+#ifdef __linux__
+
+static int open_event(int event, int group_fd) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	switch (event) {
+	case PERF_CYCLES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PERF_INSTRUCTIONS:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PERF_L1D_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+				| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case PERF_LLC_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case PERF_BRANCH_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	}
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+PerfCounters::PerfCounters() :
+		m_leader(-1), m_num_open(0), m_available(0) {
+	int error = 0;
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+		m_fds[e] = open_event(e, m_leader);
+		if (m_fds[e] < 0) {
+			error = errno;
+			continue;
+		}
+		if (m_leader == -1)
+			m_leader = m_fds[e];
+		m_order[m_num_open++] = e;
+		m_available |= 1 << e;
+	}
+	if (m_available != (1 << PERF_NUM_EVENTS) - 1) {
+		printf("Hardware counters: only %d of %d available (%s)\n",
+				m_num_open, (int) PERF_NUM_EVENTS, strerror(error));
+	}
+}
+
+PerfCounters::~PerfCounters() {
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+		if (m_fds[e] >= 0)
+			close(m_fds[e]);
+	}
+}
+
+void PerfCounters::read(PerfSample& sample) {
+	sample.clear();
+	if (m_leader < 0)
+		return;
+	// nr, time_enabled, time_running, then one value per event
+	uint64_t data[3 + PERF_NUM_EVENTS];
+	ssize_t bytes = ::read(m_leader, data, sizeof(data));
+	if (bytes < (ssize_t) (3 * sizeof(uint64_t)))
+		return;
+	uint64_t enabled = data[1], running = data[2];
+	for (uint64_t i = 0; i < data[0] && (int) i < m_num_open; ++i) {
+		uint64_t value = data[3 + i];
+		if (running > 0 && running < enabled)
+			value = (uint64_t) ((double) value * enabled / running);
+		sample.count[m_order[i]] = value;
+	}
+}
+
+#else
+
+PerfCounters::PerfCounters() :
+		m_leader(-1), m_num_open(0), m_available(0) {
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+		m_fds[e] = -1;
+	printf("Hardware counters: not available on this system\n");
+}
+
+PerfCounters::~PerfCounters() {
+}
+
+void PerfCounters::read(PerfSample& sample) {
+	sample.clear();
+}
+
+#endif
@@ -0,0 +1,79 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  PerfCounters.hpp
+ *
+ *  Hardware performance counters of the calling thread, through
+ *  perf_event_open(2). Every counter the host refuses (no PMU, a virtual
+ *  machine, perf_event_paranoid...) simply reads as 0; on other systems
+ *  than Linux none is available.
+ **************************************************************************** */
+
+#ifndef __PERF_COUNTERS_HPP__
+#define __PERF_COUNTERS_HPP__
+
+#include <stdint.h>
+
+enum PerfEvent {
+	PERF_CYCLES = 0,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES, // L1 data cache read misses
+	PERF_LLC_MISSES, // last level cache misses
+	PERF_BRANCH_MISSES,
+	PERF_NUM_EVENTS
+};
+
+struct PerfSample {
+	uint64_t count[PERF_NUM_EVENTS];
+
+	PerfSample() {
+		clear();
+	}
+	void clear() {
+		for (int i = 0; i < PERF_NUM_EVENTS; ++i)
+			count[i] = 0;
+	}
+	/** Adds the events counted between start and end */
+	void add_delta(const PerfSample& start, const PerfSample& end) {
+		for (int i = 0; i < PERF_NUM_EVENTS; ++i)
+			count[i] += end.count[i] - start.count[i];
+	}
+};
+
+class PerfCounters {
+public:
+	/** Opens the counters of the calling thread, user space only. Only that
+	 *  thread may read them. */
+	PerfCounters();
+	~PerfCounters();
+
+	bool available() const {
+		return m_available != 0;
+	}
+	/** Bit i is set if PerfEvent i is counted */
+	unsigned available_mask() const {
+		return m_available;
+	}
+
+	/** Totals since the counters were opened, scaled up when the kernel
+	 *  had to multiplex them. One system call. */
+	void read(PerfSample& sample);
+
+	static const char* event_name(int event);
+
+private:
+	int m_leader; // fd of the group leader, -1 if none
+	int m_fds[PERF_NUM_EVENTS];
+	// Events in the order the group reports them
+	int m_order[PERF_NUM_EVENTS];
+	int m_num_open;
+	unsigned m_available;
+};
+
+#endif // __PERF_COUNTERS_HPP__
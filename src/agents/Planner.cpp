@@ -0,0 +1,179 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Planner.cpp
+ *
+ *  A search tree with its own emulator, planning from states given by the
+ *  caller instead of following a game through PlayerAgent. Used by the
+ *  planning server.
+ **************************************************************************** */
+
+#include "Planner.hpp"
+#include "SearchAgent.hpp"
+#include "SearchTree.hpp"
+#include "../ale_interface.hpp"
+#include "../games/Roms.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+// Discards everything written to it
+class NullBuffer: public std::streambuf {
+protected:
+	virtual int overflow(int c) {
+		return c;
+	}
+};
+
+Planner::Planner(const std::string& rom_file,
+		const std::string& search_method, const Options& options) :
+		m_ale(NULL), m_tree(NULL), m_last_action(UNDEFINED) {
+	if (!can_load_rom(rom_file))
+		return;
+	m_ale = new ALEInterface(false);
+	Settings& settings = m_ale->theOSystem->settings();
+	for (size_t i = 0; i < options.size(); ++i) {
+		settings.setString(options[i].first, options[i].second);
+	}
+	settings.setString("search_method", search_method);
+	m_ale->loadROM(rom_file);
+
+	RomSettings* rom_settings = m_ale->settings.get();
+	StellaEnvironment* env = m_ale->environment.get();
+	m_base_state = env->cloneState();
+	m_state = m_base_state;
+
+	// Same action set as PlayerAgent
+	if (settings.getBool("restricted_action_set", false))
+		m_actions = rom_settings->getMinimalActionSet();
+	else
+		m_actions = rom_settings->getAllActions();
+
+	m_sim_steps_per_node = settings.getInt("sim_steps_per_node", true);
+	m_default_steps = settings.getInt("max_sim_steps_per_frame", false);
+	m_default_planning_ms = settings.getInt("max_planning_ms", false);
+	// Default: false
+	// The search reports its progress on std::cout; embedders rarely want it.
+	m_quiet = settings.getBool("planner_quiet", false);
+	m_stats = Stats();
+	m_stats.action = UNDEFINED;
+
+	m_tree = SearchAgent::new_search_tree(search_method, rom_settings,
+			settings, m_actions, env);
+	if (m_quiet && settings.getString("log_level", false).empty())
+		Logger::set_level(LOG_WARN);
+}
+
+Planner::~Planner() {
+	delete m_tree;
+	delete m_ale;
+}
+
+bool Planner::can_load_rom(const std::string& rom_file) {
+	FILE* file = fopen(rom_file.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	fclose(file);
+	// loadROM exits on a ROM without RomSettings
+	RomSettings* rom_settings = buildRomRLWrapper(rom_file);
+	if (rom_settings == NULL)
+		return false;
+	delete rom_settings;
+	return true;
+}
+
+bool Planner::load_state(const std::string& serialized_state) {
+	ALEState state;
+	// The deserializer throws on truncated data. A state that serializes
+	// back to other bytes had garbage appended or was not an ALEState.
+	try {
+		state = ALEState(m_base_state, serialized_state);
+	} catch (...) {
+		return false;
+	}
+	if (state.serialized() != serialized_state)
+		return false;
+	m_state = state;
+	return true;
+}
+
+Action Planner::plan(const std::string& serialized_state, int max_sim_steps,
+		int max_planning_ms, Stats& stats) {
+	if (!serialized_state.empty() && !load_state(serialized_state)) {
+		stats = Stats();
+		stats.action = UNDEFINED;
+		return UNDEFINED;
+	}
+	auto start = std::chrono::steady_clock::now();
+	ALEState& state = m_state;
+
+	NullBuffer null_buffer;
+	std::streambuf* cout_buffer = NULL;
+	if (m_quiet)
+		cout_buffer = std::cout.rdbuf(&null_buffer);
+
+	m_tree->set_step_budget(max_sim_steps > 0 ? max_sim_steps : m_default_steps);
+	m_tree->set_planning_time(
+			max_planning_ms > 0 ? max_planning_ms : m_default_planning_ms);
+
+	m_tree->forget_loaded_state();
+	m_tree->begin_decision();
+	stats.reused = false;
+	if (m_tree->is_built && m_last_action != UNDEFINED) {
+		// Same reuse as SearchAgent::act
+		m_tree->move_to_branch(m_last_action, m_sim_steps_per_node);
+		if (m_tree->get_root()->state.equals(state)) {
+			m_tree->enforce_memory_budget();
+			m_tree->update_tree();
+			stats.reused = true;
+		}
+	}
+	if (!stats.reused) {
+		m_tree->clear();
+		m_tree->build(state);
+	}
+	m_last_action = m_tree->get_best_action();
+	m_tree->end_decision();
+	if (m_quiet)
+		std::cout.rdbuf(cout_buffer);
+
+	std::chrono::duration<double, std::milli> elapsed =
+			std::chrono::steady_clock::now() - start;
+	stats.action = m_last_action;
+	stats.expanded = m_tree->expanded_nodes();
+	stats.generated = m_tree->generated_nodes();
+	stats.depth = m_tree->max_depth();
+	stats.tree_size = m_tree->num_nodes();
+	stats.root_value = m_tree->get_root_value();
+	stats.elapsed_ms = elapsed.count();
+	m_stats = stats;
+	return m_last_action;
+}
+
+reward_t Planner::step(Action action, bool& game_ended) {
+	StellaEnvironment* env = m_ale->environment.get();
+	env->restoreState(m_state);
+	m_tree->forget_loaded_state();
+
+	reward_t reward = 0;
+	game_ended = false;
+	for (int i = 0; i < m_sim_steps_per_node && !game_ended; i++) {
+		reward += env->oneStepAct(action, PLAYER_B_NOOP);
+		game_ended = env->isTerminal();
+	}
+	m_state = env->cloneState();
+	return reward;
+}
+
+void Planner::reset() {
+	m_tree->clear();
+	m_last_action = UNDEFINED;
+	m_state = m_base_state;
+}
@@ -0,0 +1,119 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Planner.hpp
+ *
+ *  A search tree with its own emulator, planning from states given by the
+ *  caller instead of following a game through PlayerAgent. Used by the
+ *  planning server and the C API of ale_planner.h.
+ **************************************************************************** */
+
+#ifndef __PLANNER_HPP__
+#define __PLANNER_HPP__
+
+#include "Constants.h"
+#include "../environment/ale_state.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class ALEInterface;
+class SearchTree;
+
+class Planner {
+public:
+	typedef std::vector<std::pair<std::string, std::string> > Options;
+
+	struct Stats {
+		Action action;
+		unsigned expanded;
+		unsigned generated;
+		unsigned depth;
+		int tree_size;
+		float root_value;
+		double elapsed_ms;
+		// The tree of the previous plan() was reused
+		bool reused;
+	};
+
+	/* *********************************************************************
+	 Constructor
+	 Loads rom_file into a new emulator whose settings are overridden by
+	 options (name, value) and creates a search tree of the given method.
+	 Check ok() before using it.
+	 ******************************************************************* */
+	Planner(const std::string& rom_file, const std::string& search_method,
+			const Options& options);
+
+	~Planner();
+
+	/** False if the ROM cannot be loaded or the search method is unknown */
+	bool ok() const {
+		return m_tree != NULL;
+	}
+
+	/** True if rom_file is readable and a supported game. ALE exits the
+	 *  process when asked to load any other file. */
+	static bool can_load_rom(const std::string& rom_file);
+
+	/** Makes a serialized ALEState the current state. False, leaving the
+	 *  current state unchanged, if the bytes are not a valid ALEState. */
+	bool load_state(const std::string& serialized_state);
+
+	/** Searches from a serialized ALEState, or from the current state if
+	 *  it is empty, and returns the best action. The state becomes the
+	 *  current one. The tree of the previous call is reused when this
+	 *  state is the one reached by its action. Budgets <= 0 fall back to
+	 *  the settings. Returns UNDEFINED if the state is not valid (see
+	 *  load_state). */
+	Action plan(const std::string& serialized_state, int max_sim_steps,
+			int max_planning_ms, Stats& stats);
+
+	/** Plays an action for sim_steps_per_node frames from the current
+	 *  state and returns the reward collected */
+	reward_t step(Action action, bool& game_ended);
+
+	/** The current state, serialized */
+	std::string current_state() {
+		return m_state.serialized();
+	}
+
+	/** Statistics of the last plan() */
+	const Stats& stats() const {
+		return m_stats;
+	}
+
+	/** Drops the tree and goes back to the start state of the game */
+	void reset();
+
+	SearchTree* tree() {
+		return m_tree;
+	}
+
+protected:
+	ALEInterface* m_ale;
+	SearchTree* m_tree;
+	ActionVect m_actions;
+	// State of the fresh emulator, used to deserialize the given states
+	ALEState m_base_state;
+	// State planned from, and moved forward by step()
+	ALEState m_state;
+	Stats m_stats;
+	// std::cout is silenced while planning (setting planner_quiet)
+	bool m_quiet;
+
+	int m_sim_steps_per_node;
+	int m_default_steps;
+	int m_default_planning_ms;
+	// Action returned by the last plan(), UNDEFINED after a reset
+	Action m_last_action;
+};
+
+#endif // __PLANNER_HPP__
@@ -0,0 +1,261 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  PlanningServer.cpp
+ *
+ *  Serves planning requests over a UNIX socket. See PlanningServer.hpp for
+ *  the protocol.
+ **************************************************************************** */
+
+#include "PlanningServer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Serialized ALEStates are a few KB; anything larger is not one
+static const size_t kMaxStateBytes = 1 << 20;
+
+// Buffered reads and whole writes on a connected socket
+class Connection {
+public:
+	Connection(int fd) :
+			m_fd(fd) {
+	}
+
+	bool read_line(std::string& line) {
+		size_t end;
+		while ((end = m_buffer.find('\n')) == std::string::npos) {
+			if (!fill())
+				return false;
+		}
+		line = m_buffer.substr(0, end);
+		m_buffer.erase(0, end + 1);
+		return true;
+	}
+
+	bool read_bytes(size_t n, std::string& bytes) {
+		while (m_buffer.size() < n) {
+			if (!fill())
+				return false;
+		}
+		bytes = m_buffer.substr(0, n);
+		m_buffer.erase(0, n);
+		return true;
+	}
+
+	bool write(const std::string& data) {
+		size_t sent = 0;
+		while (sent < data.size()) {
+			ssize_t n = ::write(m_fd, data.data() + sent, data.size() - sent);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			sent += n;
+		}
+		return true;
+	}
+
+private:
+	bool fill() {
+		char chunk[4096];
+		ssize_t n;
+		do {
+			n = ::read(m_fd, chunk, sizeof(chunk));
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return false;
+		m_buffer.append(chunk, n);
+		return true;
+	}
+
+	int m_fd;
+	std::string m_buffer;
+};
+
+PlanningServer::PlanningServer(const std::string& socket_path,
+		const Planner::Options& options) :
+		m_socket_path(socket_path), m_options(options), m_use_count(0) {
+	// Default: 16
+	// Planners kept loaded; the least recently used one is dropped first
+	m_max_planners = 16;
+	for (size_t i = 0; i < options.size(); ++i) {
+		if (options[i].first == "max_planners")
+			m_max_planners = std::max(1, atoi(options[i].second.c_str()));
+	}
+
+	sockaddr_un address;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", socket_path.c_str());
+		exit(-1);
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socket_path.c_str());
+
+	m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path.c_str());
+	if (m_listen_fd < 0
+			|| bind(m_listen_fd, (sockaddr*) &address, sizeof(address)) < 0
+			|| listen(m_listen_fd, 16) < 0) {
+		perror("PlanningServer");
+		exit(-1);
+	}
+	printf("Planning server listening on %s\n", socket_path.c_str());
+}
+
+PlanningServer::~PlanningServer() {
+	for (PlannerMap::iterator it = m_planners.begin(); it != m_planners.end();
+			++it) {
+		delete it->second.planner;
+	}
+	close(m_listen_fd);
+	unlink(m_socket_path.c_str());
+}
+
+void PlanningServer::serve() {
+	while (true) {
+		int fd = accept(m_listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("PlanningServer: accept");
+			return;
+		}
+		bool keep_serving = serve_connection(fd);
+		close(fd);
+		if (!keep_serving)
+			return;
+	}
+}
+
+Planner* PlanningServer::get_planner(const std::string& rom,
+		const std::string& method, const std::string& client) {
+	std::string key = client + '\n' + rom + '\n' + method;
+	PlannerMap::iterator it = m_planners.find(key);
+	if (it != m_planners.end()) {
+		it->second.last_use = ++m_use_count;
+		return it->second.planner;
+	}
+
+	Planner* planner = new Planner(rom, method, m_options);
+	if (!planner->ok()) {
+		delete planner;
+		return NULL;
+	}
+	while (m_planners.size() >= (size_t) m_max_planners)
+		evict_least_recently_used();
+	PlannerEntry& entry = m_planners[key];
+	entry.planner = planner;
+	entry.last_use = ++m_use_count;
+	return planner;
+}
+
+void PlanningServer::evict_least_recently_used() {
+	PlannerMap::iterator oldest = m_planners.begin();
+	for (PlannerMap::iterator it = m_planners.begin(); it != m_planners.end();
+			++it) {
+		if (it->second.last_use < oldest->second.last_use)
+			oldest = it;
+	}
+	delete oldest->second.planner;
+	m_planners.erase(oldest);
+}
+
+bool PlanningServer::serve_connection(int fd) {
+	Connection connection(fd);
+	std::string line;
+	while (connection.read_line(line)) {
+		std::istringstream request(line);
+		std::string command;
+		request >> command;
+
+		if (command == "plan") {
+			std::string rom, method, client;
+			int max_sim_steps, max_planning_ms;
+			size_t state_bytes;
+			request >> rom >> method >> max_sim_steps >> max_planning_ms
+					>> client >> state_bytes;
+			if (request.fail()) {
+				connection.write("error malformed plan request\n");
+				return true;
+			}
+			// The state is not read, so the connection cannot go on
+			if (state_bytes > kMaxStateBytes) {
+				connection.write("error state larger than 1 MB\n");
+				return true;
+			}
+			std::string state;
+			if (!connection.read_bytes(state_bytes, state))
+				return true;
+
+			// ALE exits the process on a ROM it cannot load
+			if (!Planner::can_load_rom(rom)) {
+				connection.write("error cannot load ROM " + rom + "\n");
+				continue;
+			}
+			Planner* planner = get_planner(rom, method, client);
+			if (planner == NULL) {
+				connection.write("error unknown search method " + method + "\n");
+				continue;
+			}
+			// Anonymous requests share the planner but not its tree
+			if (client == "-")
+				planner->reset();
+			if (!state.empty() && !planner->load_state(state)) {
+				connection.write("error malformed state\n");
+				continue;
+			}
+
+			Planner::Stats stats;
+			planner->plan("", max_sim_steps, max_planning_ms, stats);
+			std::ostringstream reply;
+			reply << "ok action=" << (int) stats.action;
+			reply << ",action_name=" << action_to_string(stats.action);
+			reply << ",expanded=" << stats.expanded;
+			reply << ",generated=" << stats.generated;
+			reply << ",depth=" << stats.depth;
+			reply << ",tree_size=" << stats.tree_size;
+			reply << ",value=" << stats.root_value;
+			reply << ",elapsed_ms=" << stats.elapsed_ms;
+			reply << ",reused=" << stats.reused << "\n";
+			connection.write(reply.str());
+
+		} else if (command == "forget") {
+			std::string client;
+			request >> client;
+			std::string prefix = client + '\n';
+			PlannerMap::iterator it = m_planners.begin();
+			while (it != m_planners.end()) {
+				if (it->first.compare(0, prefix.size(), prefix) == 0) {
+					delete it->second.planner;
+					m_planners.erase(it++);
+				} else {
+					++it;
+				}
+			}
+			connection.write("ok\n");
+
+		} else if (command == "quit") {
+			connection.write("ok\n");
+			return false;
+
+		} else {
+			connection.write("error unknown command " + command + "\n");
+		}
+	}
+	return true;
+}
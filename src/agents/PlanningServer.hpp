@@ -0,0 +1,76 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  PlanningServer.hpp
+ *
+ *  Serves planning requests over a UNIX socket. Emulators stay loaded
+ *  between requests, one Planner per ROM and search method, plus one per
+ *  client that wants its tree to be reused.
+ *
+ *  Protocol, one request per line:
+ *
+ *    plan <rom> <method> <max_sim_steps> <max_planning_ms> <client> <n>
+ *      followed by the n bytes (at most 1 MB) of a serialized ALEState.
+ *      Budgets <= 0 use the server settings; client "-" plans from
+ *      scratch.
+ *      -> ok action=<int>,action_name=...,expanded=...,generated=...,
+ *         depth=...,tree_size=...,value=...,elapsed_ms=...,reused=<0|1>
+ *    forget <client>   drops the trees of a client  -> ok
+ *    quit              stops the server             -> ok
+ *
+ *  Failures are answered with "error <message>". At most max_planners
+ *  (setting, default 16) planners stay loaded; the least recently used
+ *  one is dropped to make room for a new one.
+ **************************************************************************** */
+
+#ifndef __PLANNING_SERVER_HPP__
+#define __PLANNING_SERVER_HPP__
+
+#include "Planner.hpp"
+
+#include <map>
+#include <string>
+
+class PlanningServer {
+public:
+	/** options are applied to the settings of every emulator */
+	PlanningServer(const std::string& socket_path,
+			const Planner::Options& options);
+	~PlanningServer();
+
+	/** Serves connections, one at a time, until a client sends quit */
+	void serve();
+
+private:
+	/** Returns false once quit is received */
+	bool serve_connection(int fd);
+
+	/** Warm planner for a ROM and method (and client, if not "-"), or NULL
+	 *  if the method is unknown */
+	Planner* get_planner(const std::string& rom, const std::string& method,
+			const std::string& client);
+
+	void evict_least_recently_used();
+
+	struct PlannerEntry {
+		Planner* planner;
+		// Value of m_use_count when the planner was last requested
+		unsigned long last_use;
+	};
+	typedef std::map<std::string, PlannerEntry> PlannerMap;
+
+	std::string m_socket_path;
+	Planner::Options m_options;
+	int m_listen_fd;
+	PlannerMap m_planners;
+	int m_max_planners;
+	unsigned long m_use_count;
+};
+
+#endif // __PLANNING_SERVER_HPP__
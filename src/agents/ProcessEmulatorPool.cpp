@@ -0,0 +1,279 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ProcessEmulatorPool.cpp
+ *
+ *  A pool of worker processes, each one owning an emulator, that simulate
+ *  search nodes for the tree. Requests and results go through slots in a
+ *  shared memory region, so emulators never share an address space.
+ **************************************************************************** */
+
+#include "ProcessEmulatorPool.hpp"
+#include "EmulatorPool.hpp"
+#include "OSystem.hxx"
+#include "../ale_interface.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// Largest serialized state a slot can carry. Stella states are a few
+// kilobytes; carts with extra RAM stay well below this.
+static const int kMaxStateBytes = 64 * 1024;
+// Slots in the shared region; larger batches are run in several rounds
+static const int kNumSlots = 64;
+
+// Lives at the start of the shared region. Atomics of this size are
+// lock-free, hence usable across processes.
+struct ProcessPoolControl {
+	sem_t start; // one post per worker and round
+	sem_t done; // posted by the last worker to finish a round
+	std::atomic<int> next_job;
+	std::atomic<int> active;
+	int num_jobs;
+	int stop;
+};
+
+struct ProcessPoolSlot {
+	// Request
+	int act;
+	int num_steps;
+	int player_B;
+	// Result
+	int simulated_steps;
+	int first_reward;
+	int game_ended;
+	double traj_return;
+	long long context_time;
+	long long emulation_time;
+	// Serialized start state, replaced by the resulting one; -1 if the
+	// resulting state did not fit
+	int state_bytes;
+	char state[kMaxStateBytes];
+};
+
+ProcessEmulatorPool::ProcessEmulatorPool(OSystem* osystem, int num_workers) {
+	m_region_bytes = sizeof(ProcessPoolControl)
+			+ kNumSlots * sizeof(ProcessPoolSlot);
+	void* region = mmap(NULL, m_region_bytes, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED) {
+		perror("ProcessEmulatorPool: mmap");
+		exit(-1);
+	}
+	m_control = new (region) ProcessPoolControl();
+	m_slots = (char*) region + sizeof(ProcessPoolControl);
+	sem_init(&m_control->start, 1, 0);
+	sem_init(&m_control->done, 1, 0);
+	m_control->next_job = 0;
+	m_control->active = 0;
+	m_control->num_jobs = 0;
+	m_control->stop = 0;
+
+	// Buffered output would be written once more by every child
+	fflush(NULL);
+	std::cout.flush();
+	for (int i = 0; i < num_workers; ++i) {
+		pid_t pid = fork();
+		if (pid < 0) {
+			perror("ProcessEmulatorPool: fork");
+			exit(-1);
+		}
+		if (pid == 0) {
+			worker(osystem);
+		}
+		m_workers.push_back(pid);
+	}
+	printf("Emulator processes: %d workers\n", num_workers);
+}
+
+ProcessEmulatorPool::~ProcessEmulatorPool() {
+	m_control->stop = 1;
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		sem_post(&m_control->start);
+	}
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		waitpid(m_workers[i], NULL, 0);
+	}
+	sem_destroy(&m_control->start);
+	sem_destroy(&m_control->done);
+	munmap(m_control, m_region_bytes);
+}
+
+int ProcessEmulatorPool::run(std::vector<Expansion>& batch) {
+	int failed = 0;
+	size_t next = 0;
+	while (next < batch.size()) {
+		// Fills the slots with the next expansions whose state fits
+		size_t expansion_of_slot[kNumSlots];
+		int num_jobs = 0;
+		for (; next < batch.size() && num_jobs < kNumSlots; ++next) {
+			Expansion& e = batch[next];
+			e.done = false;
+			std::string data = e.state->serialized();
+			if (data.size() > (size_t) kMaxStateBytes) {
+				fprintf(stderr, "ProcessEmulatorPool: %d byte state "
+						"does not fit in a slot\n", (int) data.size());
+				failed++;
+				continue;
+			}
+			ProcessPoolSlot* s = (ProcessPoolSlot*) m_slots + num_jobs;
+			s->act = e.act;
+			s->num_steps = e.num_steps;
+			s->player_B = e.player_B;
+			s->state_bytes = data.size();
+			memcpy(s->state, data.data(), data.size());
+			expansion_of_slot[num_jobs++] = next;
+		}
+		if (num_jobs == 0) {
+			continue;
+		}
+
+		m_control->num_jobs = num_jobs;
+		m_control->next_job = 0;
+		m_control->active = m_workers.size();
+		for (size_t w = 0; w < m_workers.size(); ++w) {
+			sem_post(&m_control->start);
+		}
+		wait_for_workers();
+
+		for (int i = 0; i < num_jobs; ++i) {
+			Expansion& e = batch[expansion_of_slot[i]];
+			ProcessPoolSlot* s = (ProcessPoolSlot*) m_slots + i;
+			if (s->state_bytes < 0) {
+				fprintf(stderr, "ProcessEmulatorPool: resulting state "
+						"does not fit in a slot\n");
+				failed++;
+				continue;
+			}
+			// The serialized data holds the machine; the frame number
+			// is carried over from the start state
+			*e.state = ALEState(*e.state,
+					std::string(s->state, s->state_bytes));
+			e.state->incrementFrame(s->simulated_steps);
+			e.simulated_steps = s->simulated_steps;
+			e.traj_return = s->traj_return;
+			e.first_reward = s->first_reward;
+			e.game_ended = s->game_ended;
+			e.context_time = s->context_time;
+			e.emulation_time = s->emulation_time;
+			e.done = true;
+		}
+	}
+	return failed;
+}
+
+void ProcessEmulatorPool::wait_for_workers() {
+	while (true) {
+		timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += 1;
+		if (sem_timedwait(&m_control->done, &deadline) == 0) {
+			return;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		// A worker that died would keep us waiting forever
+		for (size_t w = 0; w < m_workers.size(); ++w) {
+			if (waitpid(m_workers[w], NULL, WNOHANG) == m_workers[w]) {
+				fprintf(stderr, "ProcessEmulatorPool: worker %d died\n",
+						(int) m_workers[w]);
+				exit(-1);
+			}
+		}
+	}
+}
+
+void ProcessEmulatorPool::worker(OSystem* osystem) {
+#ifdef __linux__
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+	ALEInterface* ale = EmulatorPool::create_emulator(osystem);
+	StellaEnvironment* env = ale->environment.get();
+	ALEState base = env->cloneState();
+
+	while (true) {
+		if (sem_wait(&m_control->start) != 0) {
+			continue;
+		}
+		if (m_control->stop) {
+			_exit(0);
+		}
+
+		int i;
+		while ((i = m_control->next_job++) < m_control->num_jobs) {
+			ProcessPoolSlot* s = (ProcessPoolSlot*) m_slots + i;
+
+			auto context_start = std::chrono::high_resolution_clock::now();
+			env->restoreState(
+					ALEState(base, std::string(s->state, s->state_bytes)));
+			s->context_time = std::chrono::duration_cast<
+					std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now()
+							- context_start).count();
+
+			// Same loop as SearchTree::simulate_on, without discounting
+			auto start = std::chrono::high_resolution_clock::now();
+			Action a = (Action) s->act;
+			env->set_player_B(s->player_B);
+			double traj_return = 0.0;
+			reward_t first_reward = 0;
+			bool game_ended = false;
+			int steps;
+			for (steps = 0; steps < s->num_steps;) {
+				reward_t curr_reward;
+				if (s->player_B)
+					curr_reward = env->oneStepAct(PLAYER_A_NOOP, a);
+				else
+					curr_reward = env->oneStepAct(a, PLAYER_B_NOOP);
+				steps++;
+				if (first_reward == 0)
+					first_reward = curr_reward;
+				traj_return += curr_reward;
+				game_ended = env->isTerminal();
+				if (game_ended)
+					break;
+			}
+			s->emulation_time = std::chrono::duration_cast<
+					std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now() - start).count();
+
+			std::string data = env->cloneState().serialized();
+			s->simulated_steps = steps;
+			s->first_reward = first_reward;
+			s->game_ended = game_ended;
+			s->traj_return = traj_return;
+			if (data.size() > (size_t) kMaxStateBytes) {
+				s->state_bytes = -1;
+			} else {
+				s->state_bytes = data.size();
+				memcpy(s->state, data.data(), data.size());
+			}
+		}
+
+		if (--m_control->active == 0) {
+			sem_post(&m_control->done);
+		}
+	}
+}
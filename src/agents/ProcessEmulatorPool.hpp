@@ -0,0 +1,84 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ProcessEmulatorPool.hpp
+ *
+ *  A pool of worker processes, each one owning an emulator, that simulate
+ *  search nodes for the tree. Requests and results go through slots in a
+ *  shared memory region, so emulators never share an address space.
+ **************************************************************************** */
+
+#ifndef __PROCESS_EMULATOR_POOL_HPP__
+#define __PROCESS_EMULATOR_POOL_HPP__
+
+#include "Constants.h"
+#include "../environment/ale_state.hpp"
+
+#include <vector>
+#include <sys/types.h>
+
+class OSystem;
+struct ProcessPoolControl;
+struct ProcessPoolSlot;
+
+class ProcessEmulatorPool {
+public:
+	/** One simulation: act for num_steps frames from *state, which is
+	 *  replaced by the resulting state */
+	struct Expansion {
+		ALEState* state;
+		Action act;
+		int num_steps;
+		bool player_B;
+
+		int simulated_steps;
+		return_t traj_return; // undiscounted, not normalized
+		reward_t first_reward;
+		bool game_ended;
+		long long context_time;
+		long long emulation_time;
+		// False if the start or the resulting state did not fit in a
+		// slot: the expansion was not simulated and *state is unchanged
+		bool done;
+	};
+
+	/* *********************************************************************
+	 Constructor
+	 Forks num_workers processes, each of which loads the ROM of the
+	 given system into its own emulator. Call it before starting any
+	 thread.
+	 ******************************************************************* */
+	ProcessEmulatorPool(OSystem* osystem, int num_workers);
+
+	/* *********************************************************************
+	 Destructor: stops the workers and waits for them to exit.
+	 ******************************************************************* */
+	~ProcessEmulatorPool();
+
+	/** Simulates every expansion of the batch on the workers and returns
+	 *  once all of them are done. act must not be RANDOM. Returns the
+	 *  number of expansions left undone (see Expansion::done), each one
+	 *  also reported on stderr. */
+	int run(std::vector<Expansion>& batch);
+
+	int size() const {
+		return m_workers.size();
+	}
+
+private:
+	void worker(OSystem* osystem);
+	void wait_for_workers();
+
+	ProcessPoolControl* m_control;
+	char* m_slots;
+	size_t m_region_bytes;
+	std::vector<pid_t> m_workers;
+};
+
+#endif // __PROCESS_EMULATOR_POOL_HPP__
@@ -24,6 +24,7 @@
 #include "BreadthFirstSearch.hpp"
 #include "IW1Search.hpp"
 #include "PIW1Search.hpp"
+#include "ParallelIW1Search.hpp"
 
 #include "UniformCostSearch.hpp"
 #include "BestFirstSearch.hpp"
@@ -39,12 +40,33 @@
 // YJ: Brute
 #include "Brute.hpp"
 
+#include "EmulatorPool.hpp"
+#include "ProcessEmulatorPool.hpp"
+#include "Telemetry.hpp"
+#include "../ale_interface.hpp"
+
+#include <chrono>
+#include <stdint.h>
+
 SearchAgent::SearchAgent(OSystem* _osystem, RomSettings* _settings,
 		StellaEnvironment* _env, bool player_B) :
 		PlayerAgent(_osystem, _settings), m_curr_action(UNDEFINED), m_current_episode(
 				0) {
 	search_method = p_osystem->settings().getString("search_method", true);
 
+	// Default: 1 (children are simulated on the main emulator)
+	// Number of worker processes simulating the children of a node, for
+	// builds whose emulator cannot run on several threads. Forked first,
+	// before the tree, the telemetry writer or the emulator pool start
+	// any thread.
+	int num_emulator_processes = p_osystem->settings().getInt(
+			"num_emulator_processes", false);
+	m_process_pool = NULL;
+	if (num_emulator_processes > 1) {
+		m_process_pool = new ProcessEmulatorPool(_osystem,
+				num_emulator_processes);
+	}
+
 	if (player_B) {
 		available_actions = _settings->getAllActions_B();
 		search_method = p_osystem->settings().getString("search_method_B",
@@ -52,56 +74,9 @@ SearchAgent::SearchAgent(OSystem* _osystem, RomSettings* _settings,
 	}
 
 	// Depending on the configuration, create a SearchTree of the requested type
-	if (search_method == "brfs") {
-		search_tree = new BreadthFirstSearch(_settings, _osystem->settings(),
-				available_actions, _env);
-		m_trace.open("brfs.search-agent.trace");
-	} else if (search_method == "ucs") {
-		search_tree = new UniformCostSearch(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		m_trace.open("ucs.search-agent.trace");
-
-	} else if (search_method == "iw1") {
-		search_tree = new IW1Search(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		search_tree->set_novelty_pruning();
-		m_trace.open("iw1.search-agent.trace");
-
-	} else if (search_method == "piw1") {
-		search_tree = new PIW1Search(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		search_tree->set_novelty_pruning();
-		m_trace.open("piw1.search-agent.trace");
-
-	} else if (search_method == "bfs") {
-		search_tree = new BestFirstSearch(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		search_tree->set_novelty_pruning();
-		m_trace.open("bfs.search-agent.trace");
-	} else if (search_method == "sips") {
-		search_tree = new SitePercolation(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		m_trace.open("sips.search-agent.trace");
-	} else if (search_method == "bips") {
-		search_tree = new BondPercolation(_settings, _osystem->settings(),
-				available_actions, _env);
-
-		m_trace.open("bips.search-agent.trace");
-
-	} else if (search_method == "uct") {
-		search_tree = new UCTSearchTree(_settings, _osystem->settings(),
-				available_actions, _env);
-		m_trace.open("uct.search-agent.trace");
-	} else if (search_method == "brute") {
-		search_tree = new Brute(_settings, _osystem->settings(),
-				available_actions, _env);
-		m_trace.open("brute.search-agent.trace");
-	} else {
+	search_tree = new_search_tree(search_method, _settings,
+			_osystem->settings(), available_actions, _env);
+	if (search_tree == NULL) {
 		cerr << "Unknown search Method: " << search_method << endl;
 		exit(-1);
 	}
@@ -111,6 +86,54 @@ SearchAgent::SearchAgent(OSystem* _osystem, RomSettings* _settings,
 	search_tree->set_player_B(player_B);
 
 	Settings &settings = _osystem->settings();
+
+	// Default: "" (no tracing)
+	// Chrome trace (JSON) of the tracing spans of the search, written when
+	// the agent is destroyed. Needs a build with USE_TRACING := 1.
+	// chrome_trace_events (default 1048576) spans of every thread are kept.
+	m_chrome_trace = settings.getString("chrome_trace", false);
+	if (!m_chrome_trace.empty()) {
+#ifdef __USE_TRACING
+		int events = settings.getInt("chrome_trace_events", false);
+		Tracing::enable(events > 0 ? events : 1 << 20);
+		printf("Tracing spans to %s\n", m_chrome_trace.c_str());
+#else
+		printf("Built without USE_TRACING: -chrome_trace is ignored\n");
+		m_chrome_trace.clear();
+#endif
+	}
+
+	// Default: "" (off)
+	// "decision" counts cycles, instructions, cache and branch misses of
+	// every decision on the search thread, reported per generated node in
+	// the traces; "sections" also counts the emulation and the feature
+	// extraction of the search thread apart, at two counter reads each.
+	// Counters the host does not grant read as 0.
+	string perf_counters = settings.getString("perf_counters", false);
+	m_perf_counters = NULL;
+	if (perf_counters == "decision" || perf_counters == "sections") {
+		m_perf_counters = new PerfCounters();
+		search_tree->set_perf_counters(m_perf_counters,
+				perf_counters == "sections");
+		printf("Hardware counters per %s\n", perf_counters.c_str());
+	} else if (!perf_counters.empty()) {
+		printf("Unknown perf_counters %s\n", perf_counters.c_str());
+	}
+
+	// Default: "text"
+	// "binary" replaces the text trace of every decision, also printed on
+	// std::cout, by fixed-size records in <method>.search-agent.telemetry,
+	// written on a background thread. Read them with ale-telemetry-dump.
+	string trace_format = settings.getString("trace_format", false);
+	m_telemetry = NULL;
+	if (trace_format == "binary") {
+		m_telemetry = new TelemetryWriter(
+				search_method + ".search-agent.telemetry");
+		printf("Binary telemetry in %s.search-agent.telemetry\n",
+				search_method.c_str());
+	} else {
+		m_trace.open((search_method + ".search-agent.trace").c_str());
+	}
 	sim_steps_per_node = settings.getInt("sim_steps_per_node", true);
 
 	erroneous_action = settings.getBool("erroneous_action", false);
@@ -122,13 +145,101 @@ SearchAgent::SearchAgent(OSystem* _osystem, RomSettings* _settings,
 		printf("Action Error Rate = %f\n", action_error_rate);
 	}
 
+	if (m_process_pool != NULL) {
+		search_tree->set_process_pool(m_process_pool);
+	}
+
+	// Default: 1 (children are simulated on the main emulator)
+	// Number of worker emulators simulating the children of a node.
+	int num_emulator_threads = settings.getInt("num_emulator_threads", false);
+	m_emulator_pool = NULL;
+	if (num_emulator_threads > 1) {
+		m_emulator_pool = new EmulatorPool(_osystem, num_emulator_threads);
+		search_tree->set_emulator_pool(m_emulator_pool);
+	}
+
+	// Default: "" (nothing recorded)
+	// File the root state of every decision is appended to, each one as
+	// its size (4 bytes, host order) followed by the serialized ALEState.
+	string root_states_file = settings.getString("record_root_states", false);
+	if (!root_states_file.empty()) {
+		m_root_states.open(root_states_file.c_str(),
+				std::ios::binary | std::ios::app);
+		printf("Recording root states to %s\n", root_states_file.c_str());
+	}
+
+	// Default: false
+	// The subtree of the chosen action is searched on a background thread
+	// while that action is executed.
+	m_speculative_ale = NULL;
+	m_speculating = false;
+	m_speculation_time = 0;
+	if (settings.getBool("speculative_planning", false)) {
+		m_speculative_ale = EmulatorPool::create_emulator(_osystem);
+		printf("Speculative planning\n");
+	}
+
 	m_curr_action_duration = 0;
 	m_curr_action_duration_left = 0;
 }
 
+SearchTree* SearchAgent::new_search_tree(const string& search_method,
+		RomSettings* rom_settings, Settings& settings, ActionVect& actions,
+		StellaEnvironment* env) {
+	SearchTree* tree = NULL;
+	if (search_method == "brfs") {
+		tree = new BreadthFirstSearch(rom_settings, settings, actions, env);
+	} else if (search_method == "ucs") {
+		tree = new UniformCostSearch(rom_settings, settings, actions, env);
+	} else if (search_method == "iw1") {
+		tree = new IW1Search(rom_settings, settings, actions, env);
+		tree->set_novelty_pruning();
+	} else if (search_method == "piw1") {
+		tree = new PIW1Search(rom_settings, settings, actions, env);
+		tree->set_novelty_pruning();
+	} else if (search_method == "parallel_iw1") {
+		tree = new ParallelIW1Search(rom_settings, settings, actions, env,
+				false);
+		tree->set_novelty_pruning();
+	} else if (search_method == "parallel_piw1") {
+		tree = new ParallelIW1Search(rom_settings, settings, actions, env,
+				true);
+		tree->set_novelty_pruning();
+	} else if (search_method == "bfs") {
+		tree = new BestFirstSearch(rom_settings, settings, actions, env);
+		tree->set_novelty_pruning();
+	} else if (search_method == "sips") {
+		tree = new SitePercolation(rom_settings, settings, actions, env);
+	} else if (search_method == "bips") {
+		tree = new BondPercolation(rom_settings, settings, actions, env);
+	} else if (search_method == "uct") {
+		tree = new UCTSearchTree(rom_settings, settings, actions, env);
+	} else if (search_method == "brute") {
+		tree = new Brute(rom_settings, settings, actions, env);
+	}
+	return tree;
+}
+
 SearchAgent::~SearchAgent() {
+	finish_speculation();
+	delete m_speculative_ale;
 
 	m_trace.close();
+	delete m_telemetry;
+	search_tree->set_perf_counters(NULL, false);
+	delete m_perf_counters;
+	if (!m_chrome_trace.empty()
+			&& !Tracing::write_chrome_trace(m_chrome_trace)) {
+		cerr << "Could not write " << m_chrome_trace << endl;
+	}
+	if (m_emulator_pool != NULL) {
+		search_tree->set_emulator_pool(NULL);
+		delete m_emulator_pool;
+	}
+	if (m_process_pool != NULL) {
+		search_tree->set_process_pool(NULL);
+		delete m_process_pool;
+	}
 }
 
 int SearchAgent::num_available_actions() {
@@ -162,29 +273,59 @@ Action SearchAgent::act() {
 		--m_curr_action_duration_left;
 		return m_curr_action;
 	}
-	std::cout << "Search Agent action selection: frame=" << frame_number
-			<< std::endl;
-	std::cout << "Is Terminal Before Lookahead? "
-			<< m_rom_settings->isTerminal() << std::endl;
-	std::cout << "Evaluating actions: " << std::endl;
-
+	LOG(LOG_DEBUG, "Search Agent action selection: frame=%d\n",
+			(int) frame_number);
+	LOG(LOG_DEBUG, "Is Terminal Before Lookahead? %d\n",
+			(int) m_rom_settings->isTerminal());
+	LOG(LOG_DEBUG, "Evaluating actions: \n");
+
+	// The decision starts now: stopping the speculative search counts in
+	// its latency
 	float t0 = aptk::time_used();
+	auto decision_start = std::chrono::steady_clock::now();
+
+	// The speculative search already moved the tree to the branch. Stop it
+	// before touching the tree.
+	bool speculated = finish_speculation();
+	// The game moved on since the last search (finish_speculation() already
+	// handed m_env back to the tree with no state loaded)
+	if (!speculated)
+		search_tree->forget_loaded_state();
+
+	PerfSample perf_start;
+	if (m_perf_counters != NULL)
+		m_perf_counters->read(perf_start);
 
 	m_env->getScreen();
 	state = m_env->cloneState();
 
+	if (m_root_states.is_open()) {
+		std::string data = state.serialized();
+		uint32_t size = data.size();
+		m_root_states.write((const char*) &size, sizeof(size));
+		m_root_states.write(data.data(), data.size());
+	}
+
+	search_tree->begin_decision(speculated, decision_start);
+
 	if (search_tree->is_built) {
 		// Re-use the old tree
-		search_tree->move_to_branch(m_curr_action, m_curr_action_duration);
+		if (!speculated)
+			search_tree->move_to_branch(m_curr_action, m_curr_action_duration);
 //		search_tree->move_to_best_sub_branch();
 		//assert(search_tree->get_root()->state.equals(state));
 		if (search_tree->get_root()->state.equals(state)) {
 			//assert(search_tree->get_root()->state.equals(state));
 			//assert (search_tree->get_root_frame_number() == state.getFrameNumber());
+			if (speculated)
+				search_tree->record_speculation(true, m_speculation_time);
+			search_tree->enforce_memory_budget();
 			search_tree->update_tree();
 
 		} else {
 			//std::cout << "\n\n\tDIFFERENT STATE!\n" << std::endl;
+			if (speculated)
+				search_tree->record_speculation(false, m_speculation_time);
 			search_tree->clear();
 			search_tree->build(state);
 		}
@@ -195,6 +336,7 @@ Action SearchAgent::act() {
 	}
 
 	m_curr_action = search_tree->get_best_action();
+	search_tree->end_decision();
 
 	// TOREFACTOR: these commands should be emplaced within SearchTree.
 	search_tree->getJunkActionSequence(frame_number); // TODO: messy
@@ -202,23 +344,45 @@ Action SearchAgent::act() {
 
 	m_env->restoreState(state);
 
-	std::cout << "Is Terminal After Lookahead? " << m_rom_settings->isTerminal()
-			<< std::endl;
+	LOG(LOG_DEBUG, "Is Terminal After Lookahead? %d\n",
+			(int) m_rom_settings->isTerminal());
+
+	if (m_perf_counters != NULL) {
+		PerfSample perf_end, decision;
+		m_perf_counters->read(perf_end);
+		decision.add_delta(perf_start, perf_end);
+		search_tree->record_decision_counters(decision);
+	}
 
 	float tf = aptk::time_used();
 
 	float elapsed = tf - t0;
 
-	search_tree->print_frame_data(frame_number, elapsed, m_curr_action,
-			m_trace);
-	search_tree->print_frame_data(frame_number, elapsed, m_curr_action,
-			std::cout);
+	if (m_telemetry != NULL) {
+		TelemetryRecord record;
+		search_tree->fill_telemetry(record);
+		record.episode = m_current_episode;
+		record.frame = frame_number;
+		record.action = m_curr_action;
+		record.elapsed = elapsed;
+		m_telemetry->write(record);
+	} else {
+		search_tree->print_frame_data(frame_number, elapsed, m_curr_action,
+				m_trace);
+		if (Logger::enabled(LOG_DEBUG)) {
+			std::ostringstream frame_data;
+			search_tree->print_frame_data(frame_number, elapsed,
+					m_curr_action, frame_data);
+			LOG(LOG_DEBUG, "%s", frame_data.str().c_str());
+		}
+	}
 
 	int duration = sim_steps_per_node;
 	if (erroneous_action) {
 		Action m = randomizeAction(m_curr_action);
 		if (m != m_curr_action) {
-			printf("Randomized from %d to %d\n", (int) m_curr_action, (int) m);
+			LOG(LOG_DEBUG, "Randomized from %d to %d\n", (int) m_curr_action,
+					(int) m);
 			m_curr_action = m;
 			search_tree->set_best_action(m_curr_action);
 		}
@@ -228,20 +392,64 @@ Action SearchAgent::act() {
 			} else {
 				duration -= 1;
 			}
-			printf("duration = %d\n", duration);
+			LOG(LOG_DEBUG, "duration = %d\n", duration);
 		}
 	}
 	m_curr_action_duration = duration;
 	m_curr_action_duration_left = duration - 1;
 
+	start_speculation();
+
 	return m_curr_action;
 }
 
+void SearchAgent::start_speculation() {
+	if (m_speculative_ale == NULL || !search_tree->is_built
+			|| search_tree->get_root()->v_children.empty()) {
+		return;
+	}
+	// Until finish_speculation() only the background thread uses the tree
+	search_tree->set_environment(m_speculative_ale->environment.get());
+	m_speculating = true;
+	m_speculation_thread = std::thread([this]() {
+		auto start = std::chrono::high_resolution_clock::now();
+		search_tree->begin_decision();
+		search_tree->move_to_branch(m_curr_action, m_curr_action_duration);
+		search_tree->enforce_memory_budget();
+		search_tree->update_tree();
+		auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_speculation_time = std::chrono::duration_cast<
+				std::chrono::microseconds>(elapsed).count();
+	});
+}
+
+bool SearchAgent::finish_speculation() {
+	if (!m_speculating) {
+		return false;
+	}
+	// It only gets the time the game took to reach the next decision; the
+	// search goes on from its tree with the whole budget
+	search_tree->request_stop();
+	m_speculation_thread.join();
+	search_tree->clear_stop();
+	m_speculating = false;
+	search_tree->set_environment(m_env);
+	return true;
+}
+
 /* *********************************************************************
  This method is called when the game ends.
  ******************************************************************** */
 void SearchAgent::episode_end(void) {
 	PlayerAgent::episode_end();
+	finish_speculation();
+	// Splits the trace into episodes
+	if (m_trace.is_open())
+		m_trace << "episode_end=" << m_current_episode << ",episode_frames="
+				<< episode_frame_number << std::endl;
+	if (m_telemetry != NULL)
+		m_telemetry->flush();
+	Logger::flush();
 	// Our search-tree is useless now. Clear it
 	search_tree->clear();
 
@@ -23,6 +23,12 @@
 #include "../environment/ale_state.hpp"
 #include "SearchTree.hpp"
 #include <fstream>
+#include <thread>
+
+class EmulatorPool;
+class ProcessEmulatorPool;
+class TelemetryWriter;
+class ALEInterface;
 
 class SearchAgent: public PlayerAgent {
 public:
@@ -41,6 +47,12 @@ public:
 
 	void saveUsedAction(int frame_number, Action action);
 
+	/** Creates a search tree of the given method (see -search_method), or
+	 *  returns NULL if there is no such method */
+	static SearchTree* new_search_tree(const string& search_method,
+			RomSettings* rom_settings, Settings& settings,
+			ActionVect& actions, StellaEnvironment* env);
+
 protected:
 	/* *********************************************************************
 	 Returns the best action from the set of possible actions
@@ -58,6 +70,14 @@ protected:
 
 	Action randomizeAction(Action a);
 protected:
+	/** Starts moving the tree to the branch of the action just chosen and
+	 *  searching from there on a background thread, while the action is
+	 *  being executed on m_env */
+	void start_speculation();
+
+	/** Waits for the speculative search; returns false if none ran */
+	bool finish_speculation();
+
 	Action m_curr_action;
 	int m_curr_action_duration;
 	int m_curr_action_duration_left;
@@ -70,9 +90,29 @@ protected:
 	string search_method;
 	unsigned m_current_episode;
 	std::ofstream m_trace;
+	// Binary trace, replacing m_trace (NULL if disabled)
+	TelemetryWriter* m_telemetry;
+	// Hardware counters of the decisions (NULL if disabled)
+	PerfCounters* m_perf_counters;
+	// Chrome trace written on destruction ("" if disabled)
+	string m_chrome_trace;
 
 	bool erroneous_action;
 	float action_error_rate;
+
+	// Worker emulators shared with the search tree (NULL if disabled)
+	EmulatorPool* m_emulator_pool;
+	// Worker processes simulating the children of a node (NULL if disabled)
+	ProcessEmulatorPool* m_process_pool;
+
+	// Root state of every decision, for ale-search-bench (if open)
+	std::ofstream m_root_states;
+
+	// Emulator of the speculative search (NULL if disabled)
+	ALEInterface* m_speculative_ale;
+	std::thread m_speculation_thread;
+	bool m_speculating;
+	long long m_speculation_time;
 //	bool use_image;
 };
 
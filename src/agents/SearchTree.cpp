@@ -18,10 +18,16 @@
 
 //#include <time.h>
 #include <chrono>
+#include <algorithm>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include "DominatedActionSequenceDetection.hpp"
 #include "DominatedActionSequencePruning.hpp"
 #include "DominatedActionSequenceAvoidance.hpp"
+#include "TreeReclaimer.hpp"
+#include "EmulatorPool.hpp"
 
 /* *********************************************************************
  Constructor
@@ -56,11 +62,50 @@ SearchTree::SearchTree(RomSettings * rom_settings, Settings & settings,
 	m_novelty_pruning = false;
 	m_player_B = false;
 
-	m_emulation_time = 0;
-	m_context_time = 0;
+	// Default: -1 (no wall-clock budget)
+	// Milliseconds a decision may plan for; the search stops at the first
+	// check past the deadline and acts on what it has.
+	m_max_planning_ms = settings.getInt("max_planning_ms", false);
+	// Default: -1 (fixed step budget)
+	// Target p99 decision latency; the step budget shrinks while it is
+	// exceeded and grows back once there is room.
+	m_planning_slo_ms = settings.getInt("planning_slo_ms", false);
+	init_state();
+	// Default: "info"
+	// Verbosity of the search output: error, warn, info, debug (a few lines
+	// per decision) or trace (lines from inside the search loops). Messages
+	// of disabled levels are not even formatted.
+	string log_level = settings.getString("log_level", false);
+	if (!log_level.empty() && !Logger::set_level(log_level)) {
+		printf("Unknown log_level %s\n", log_level.c_str());
+	}
+
+	if (m_max_planning_ms > 0) {
+		printf("Planning budget: %d ms\n", m_max_planning_ms);
+	}
+	if (m_planning_slo_ms > 0) {
+		printf("Planning latency SLO (p99): %d ms\n", m_planning_slo_ms);
+	}
+
+	// Default: false
+	// Discarded subtrees are freed on a background thread.
+	if (settings.getBool("background_reclamation", false)) {
+		m_reclaimer = new TreeReclaimer();
+		printf("Background reclamation of discarded subtrees\n");
+	}
+
+	// Default: unbounded
+	// Budget in megabytes for the nodes kept across decisions.
+	int memory_budget = settings.getInt("tree_memory_budget", false);
+	m_memory_budget = 0;
+	if (memory_budget > 0) {
+		m_memory_budget = (size_t) memory_budget * 1024 * 1024;
+		printf("Tree memory budget= %d MB\n", memory_budget);
+	}
 
 	action_sequence_detection = settings.getBool("action_sequence_detection",
 			false);
+	m_owns_dasd = action_sequence_detection;
 
 	if (action_sequence_detection) {
 		printf("RUNNING ACTION SEQUENCE DETECTION\n");
@@ -108,12 +153,89 @@ SearchTree::SearchTree(RomSettings * rom_settings, Settings & settings,
 
 }
 
+SearchTree::SearchTree(const SearchTree& parent, StellaEnvironment* _env) :
+		is_built(false), p_root(NULL), sim_steps_per_node(
+				parent.sim_steps_per_node), max_sim_steps_per_frame(
+				parent.max_sim_steps_per_frame), num_simulations_per_frame(
+				parent.num_simulations_per_frame), discount_factor(
+				parent.discount_factor), depth_normalized_reward(
+				parent.depth_normalized_reward), normalize_rewards(
+				parent.normalize_rewards), ignore_duplicates(
+				parent.ignore_duplicates), reward_magnitude(0), m_rom_settings(
+				parent.m_rom_settings), available_actions(
+				parent.available_actions), total_simulation_steps(0) {
+	m_env = _env;
+	m_randomize_successor = parent.m_randomize_successor;
+	m_novelty_pruning = parent.m_novelty_pruning;
+	m_player_B = parent.m_player_B;
+
+	// The parent adapts the budgets and enforces the memory budget
+	m_max_planning_ms = parent.m_max_planning_ms;
+	m_planning_slo_ms = -1;
+	m_memory_budget = 0;
+	init_state();
+	m_stop = parent.m_stop;
+
+	action_sequence_detection = parent.action_sequence_detection;
+	dasd = parent.dasd;
+	dasd_sequence_length = parent.dasd_sequence_length;
+	m_owns_dasd = false;
+
+	image_based = parent.image_based;
+	erroneous_prediction = parent.erroneous_prediction;
+	prediction_error_rate = parent.prediction_error_rate;
+}
+
+void SearchTree::init_state() {
+	m_emulation_time = 0;
+	m_context_time = 0;
+	m_feature_time = 0;
+	m_teardown_time = 0;
+	m_emulator_pool = NULL;
+	m_process_pool = NULL;
+	m_parallel_time = 0;
+	m_perf = NULL;
+	m_perf_sections = false;
+	m_reclaimer = NULL;
+
+	m_loaded_state = NULL;
+	m_env_restores = 0;
+	m_env_restore_time = 0;
+	m_skipped_restores = 0;
+	m_skipped_clones = 0;
+
+	m_speculation_hits = 0;
+	m_speculation_misses = 0;
+	m_speculation_time = 0;
+
+	m_step_budget = max_sim_steps_per_frame;
+	m_budget_scale = 1.0;
+	m_timed_out = false;
+	m_decisions_since_rescale = 0;
+	m_latency_p50 = 0;
+	m_latency_p99 = 0;
+	m_decision_start = std::chrono::steady_clock::now();
+	m_planning_deadline = m_decision_start;
+	m_stop_flag = false;
+	m_stop = &m_stop_flag;
+
+	m_state_bytes = 0;
+	m_tree_bytes = 0;
+	m_peak_tree_bytes = 0;
+	m_peak_memory_bytes = 0;
+	m_decision_memory_valid = false;
+	m_evicted_nodes = 0;
+	m_evicted_subtrees = 0;
+	m_total_evicted_nodes = 0;
+}
+
 /* *********************************************************************
  Deletes the search-tree
  ******************************************************************* */
 void SearchTree::clear(void) {
+	m_loaded_state = NULL;
 	if (p_root != NULL) {
-		delete_branch(p_root);
+		discard_branch(p_root);
 		p_root = NULL;
 	}
 	is_built = false;
@@ -126,9 +248,12 @@ void SearchTree::clear(void) {
  ******************************************************************* */
 SearchTree::~SearchTree(void) {
 	clear();
-	if (action_sequence_detection) {
+	if (m_owns_dasd) {
 		delete dasd;
 	}
+	if (m_reclaimer != NULL) {
+		delete m_reclaimer;
+	}
 }
 
 /* *********************************************************************
@@ -193,18 +318,20 @@ Action SearchTree::get_best_action(void) {
 		// 	// when we have more than one best-branch, pick one randomly
 		best_branch = choice(&best_branches);
 	}
-	for (size_t c = 0; c < p_root->v_children.size(); c++) {
-		TreeNode* curr_child = p_root->v_children[c];
-
-		std::cout << "Action: " << action_to_string(curr_child->act)
-				<< " Depth: " << curr_child->branch_depth << " NumNodes: "
-				<< curr_child->num_nodes() << " Reward: "
-				<< curr_child->branch_return << std::endl;
+	// num_nodes() walks the whole subtree: only when the line is printed
+	if (Logger::enabled(LOG_DEBUG)) {
+		for (size_t c = 0; c < p_root->v_children.size(); c++) {
+			TreeNode* curr_child = p_root->v_children[c];
 
+			LOG(LOG_DEBUG, "Action: %s Depth: %g NumNodes: %d Reward: %g\n",
+					action_to_string(curr_child->act).c_str(),
+					(double) curr_child->branch_depth, curr_child->num_nodes(),
+					(double) curr_child->branch_return);
+		}
 	}
 
 	p_root->best_branch = best_branch;
-	printf("best_branch=%s\n",
+	LOG(LOG_DEBUG, "best_branch=%s\n",
 			action_to_string(p_root->available_actions[best_branch]).c_str());
 	return p_root->available_actions[best_branch];
 }
@@ -213,6 +340,7 @@ Action SearchTree::get_best_action(void) {
  Moves the best sub-branch of the root to be the new root of the tree
  ******************************************************************* */
 void SearchTree::move_to_best_sub_branch(void) {
+	m_loaded_state = NULL;
 	assert(p_root->v_children.size() > 0);
 	assert(p_root->best_branch != -1);
 
@@ -222,7 +350,7 @@ void SearchTree::move_to_best_sub_branch(void) {
 			continue;
 		}
 		if (del != (size_t) p_root->best_branch) {
-			delete_branch(p_root->v_children[del]);
+			discard_branch(p_root->v_children[del]);
 		}
 	}
 
@@ -236,6 +364,7 @@ void SearchTree::move_to_best_sub_branch(void) {
 }
 
 void SearchTree::move_to_branch(Action a, int duration) {
+	m_loaded_state = NULL;
 	assert(p_root->v_children.size() > 0);
 	int best_branch = -1;
 	if (duration == sim_steps_per_node) {
@@ -248,12 +377,12 @@ void SearchTree::move_to_branch(Action a, int duration) {
 				continue;
 			}
 			if (p_root->v_children[del]->act != a) {
-				delete_branch(p_root->v_children[del]);
+				discard_branch(p_root->v_children[del]);
 			} else {
 				if (newChild->state.equals(p_root->v_children[del]->state)) {
 					best_branch = del;
 				} else {
-					printf("Prediction error\n");
+					LOG(LOG_DEBUG, "Prediction error\n");
 					prediction_error = true;
 				}
 			}
@@ -287,7 +416,7 @@ void SearchTree::move_to_branch(Action a, int duration) {
 				best_branch = i;
 				break;
 			} else {
-				delete_branch(p_root->v_children[i]);
+				discard_branch(p_root->v_children[i]);
 			}
 		}
 		if (best_branch != -1) {
@@ -310,6 +439,7 @@ void SearchTree::move_to_branch(Action a, int duration) {
 		}
 
 		m_env->restoreState(buffer);
+		m_loaded_state = NULL;
 	}
 
 }
@@ -318,6 +448,7 @@ void SearchTree::move_to_branch(Action a, int duration) {
  Deletes a node and all its children, all the way down the branch
  ******************************************************************* */
 void SearchTree::delete_branch(TreeNode* node) {
+	m_loaded_state = NULL;
 	if (!node->v_children.empty()) {
 		for (size_t c = 0; c < node->v_children.size(); c++) {
 			if (node->v_children[c] == nullptr) {
@@ -330,7 +461,200 @@ void SearchTree::delete_branch(TreeNode* node) {
 
 }
 
+void SearchTree::discard_branch(TreeNode* node) {
+	TRACE_SPAN("teardown");
+	auto start = std::chrono::high_resolution_clock::now();
+	m_loaded_state = NULL;
+
+	if (m_reclaimer != NULL) {
+		m_reclaimer->reclaim(node);
+	} else {
+		delete_branch(node);
+	}
+
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_teardown_time += std::chrono::duration_cast<std::chrono::microseconds>(
+			elapsed).count();
+}
+
+// Bytes a heap block of the given size really takes: glibc rounds every
+// request up to a multiple of 16 with an 8 byte header, 32 bytes at least
+static size_t chunk_bytes(size_t size) {
+	if (size == 0)
+		return 0;
+	size_t chunk = (size + sizeof(size_t) + 2 * sizeof(size_t) - 1)
+			& ~(2 * sizeof(size_t) - 1);
+	return std::max(chunk, 4 * sizeof(size_t));
+}
+
+// Same as chunk_bytes(size), but asks the allocator when it can. Only works
+// for blocks we hold a pointer to: ALEState keeps its serialized string to
+// itself, so states are estimated with chunk_bytes().
+static size_t heap_bytes(const void* block, size_t size) {
+	if (block == NULL || size == 0)
+		return 0;
+#ifdef __GLIBC__
+	return malloc_usable_size(const_cast<void*>(block)) + sizeof(size_t);
+#else
+	return chunk_bytes(size);
+#endif
+}
+
+void SearchTree::count_node(TreeNode* node, MemoryUsage& usage) {
+	if (m_state_bytes == 0) {
+		// Estimate: the string of the state plus its terminating null
+		m_state_bytes = chunk_bytes(node->state.serialized().size() + 1);
+	}
+	usage.states += m_state_bytes;
+	usage.nodes += heap_bytes(node, sizeof(TreeNode));
+	usage.children += heap_bytes(node->v_children.data(),
+			node->v_children.capacity() * sizeof(TreeNode*));
+	usage.actions += heap_bytes(node->available_actions.data(),
+			node->available_actions.capacity() * sizeof(Action));
+}
+
+void SearchTree::count_subtree(TreeNode* node, MemoryUsage& usage,
+		unsigned& nodes) {
+	count_node(node, usage);
+	++nodes;
+	for (size_t c = 0; c < node->v_children.size(); c++) {
+		if (node->v_children[c] == nullptr) {
+			continue;
+		}
+		count_subtree(node->v_children[c], usage, nodes);
+	}
+}
+
+size_t SearchTree::node_bytes(TreeNode* node) {
+	MemoryUsage usage;
+	count_node(node, usage);
+	return usage.tree();
+}
+
+size_t SearchTree::subtree_bytes(TreeNode* node, unsigned& nodes) {
+	MemoryUsage usage;
+	count_subtree(node, usage, nodes);
+	return usage.tree();
+}
+
+size_t SearchTree::tree_bytes() {
+	if (p_root == NULL) {
+		return 0;
+	}
+	unsigned nodes = 0;
+	size_t bytes = subtree_bytes(p_root, nodes);
+	m_peak_tree_bytes = std::max(m_peak_tree_bytes, bytes);
+	return bytes;
+}
+
+MemoryUsage SearchTree::memory_usage() {
+	MemoryUsage usage;
+	if (p_root != NULL) {
+		unsigned nodes = 0;
+		count_subtree(p_root, usage, nodes);
+	}
+	usage.novelty = novelty_bytes();
+	m_peak_tree_bytes = std::max(m_peak_tree_bytes, usage.tree());
+	m_peak_memory_bytes = std::max(m_peak_memory_bytes, usage.total());
+	return usage;
+}
+
+const MemoryUsage& SearchTree::decision_memory() {
+	if (!m_decision_memory_valid) {
+		m_decision_memory = memory_usage();
+		m_decision_memory_valid = true;
+	}
+	return m_decision_memory;
+}
+
+size_t SearchTree::collapse_node(TreeNode* node) {
+	unsigned nodes = 0;
+	size_t before = subtree_bytes(node, nodes);
+	for (size_t c = 0; c < node->v_children.size(); c++) {
+		if (node->v_children[c] == nullptr) {
+			continue;
+		}
+		discard_branch(node->v_children[c]);
+	}
+	NodeList().swap(node->v_children);
+	node->best_branch = -1;
+	node->already_expanded = false;
+
+	m_evicted_nodes += nodes - 1;
+	m_total_evicted_nodes += nodes - 1;
+	m_evicted_subtrees++;
+	return before - node_bytes(node);
+}
+
+void SearchTree::enforce_memory_budget() {
+	m_evicted_nodes = 0;
+	m_evicted_subtrees = 0;
+	// Measuring the tree walks all of it: not without a budget
+	if (m_memory_budget == 0) {
+		return;
+	}
+	m_tree_bytes = tree_bytes();
+	if (m_tree_bytes <= m_memory_budget) {
+		return;
+	}
+
+	// Internal nodes below the root's children, paired with their depth.
+	// Duplicate and terminal nodes are never expanded again, so whatever
+	// hangs below them is evicted first.
+	vector<pair<unsigned, TreeNode*> > dead;
+	vector<pair<unsigned, TreeNode*> > live;
+	vector<pair<unsigned, TreeNode*> > stack;
+	for (size_t c = 0; c < p_root->v_children.size(); c++) {
+		if (p_root->v_children[c] != nullptr) {
+			stack.push_back(make_pair(1u, p_root->v_children[c]));
+		}
+	}
+	while (!stack.empty()) {
+		pair<unsigned, TreeNode*> curr = stack.back();
+		stack.pop_back();
+		TreeNode* node = curr.second;
+		if (node->v_children.empty()) {
+			continue;
+		}
+		if (node->is_terminal || node->is_duplicate()) {
+			dead.push_back(curr);
+			continue;
+		}
+		if (curr.first > 1) {
+			live.push_back(curr);
+		}
+		for (size_t c = 0; c < node->v_children.size(); c++) {
+			if (node->v_children[c] != nullptr) {
+				stack.push_back(make_pair(curr.first + 1, node->v_children[c]));
+			}
+		}
+	}
+
+	for (size_t i = 0; i < dead.size() && m_tree_bytes > m_memory_budget;
+			++i) {
+		m_tree_bytes -= collapse_node(dead[i].second);
+	}
+
+	// Deepest first, so a node is always collapsed after its descendants and
+	// no pointer in the list is left dangling. Ties go to the lowest return.
+	std::stable_sort(live.begin(), live.end(),
+			[](const pair<unsigned, TreeNode*>& a,
+					const pair<unsigned, TreeNode*>& b) {
+				if (a.first != b.first)
+					return a.first > b.first;
+				return a.second->branch_return < b.second->branch_return;
+			});
+	for (size_t i = 0; i < live.size() && m_tree_bytes > m_memory_budget;
+			++i) {
+		m_tree_bytes -= collapse_node(live[i].second);
+	}
+
+	LOG(LOG_DEBUG, "Evicted %u nodes in %u subtrees (tree: %zu bytes)\n",
+			m_evicted_nodes, m_evicted_subtrees, m_tree_bytes);
+}
+
 bool SearchTree::test_duplicate(TreeNode *node) {
+	TRACE_SPAN("test_duplicate");
 	// TODO: Image based is problematic when the action does not give immediate difference.
 	if (image_based && node->p_parent == this->p_root) {
 		return false;
@@ -377,23 +701,70 @@ bool SearchTree::test_duplicate(TreeNode *node) {
 int SearchTree::simulate_game(ALEState & state, Action act, int num_steps,
 		return_t &traj_return, bool &game_ended, bool discount_return,
 		bool save_state) {
+	reward_t first_reward;
+	long long context_time = 0;
+	long long emulation_time = 0;
+
+	int i = simulate_on(m_env, state, act, num_steps, traj_return,
+			first_reward, game_ended, discount_return, save_state,
+			context_time, emulation_time);
+
+	m_context_time += context_time;
+	m_emulation_time += emulation_time;
+	m_total_simulation_steps += i;
+
+	if (normalize_rewards)
+		traj_return = normalize_return(traj_return, first_reward);
+
+	return i;
+}
+
+int SearchTree::simulate_on(StellaEnvironment* env, ALEState & state,
+		Action act, int num_steps, return_t &traj_return,
+		reward_t &first_reward, bool &game_ended, bool discount_return,
+		bool save_state, long long &context_time, long long &emulation_time) {
+	TRACE_SPAN("simulate");
+
+	// Nothing to simulate (e.g. the dummy nodes of action sequence
+	// detection): the state stays as it is, no need to restore or clone it
+	if (num_steps <= 0) {
+		traj_return = 0.0;
+		first_reward = 0;
+		game_ended = false;
+		if (env == m_env) {
+			m_skipped_restores++;
+			if (save_state)
+				m_skipped_clones++;
+		}
+		return 0;
+	}
 
 	// Load the state into the emulator - a copy of the parent state
-	auto context_start = std::chrono::high_resolution_clock::now();
+	if (env == m_env && m_loaded_state == &state) {
+		m_skipped_restores++;
+	} else {
+		TRACE_SPAN("restoreState");
+		auto context_start = std::chrono::high_resolution_clock::now();
 
-	m_env->restoreState(state);
+		env->restoreState(state);
 
-	auto context_elapsed = std::chrono::high_resolution_clock::now()
-			- context_start;
-	long long context_microseconds = std::chrono::duration_cast<
-			std::chrono::microseconds>(context_elapsed).count();
-//	printf("t=%.2f, %lld, microseconds);
+		auto context_elapsed = std::chrono::high_resolution_clock::now()
+				- context_start;
+		long long context_microseconds = std::chrono::duration_cast<
+				std::chrono::microseconds>(context_elapsed).count();
+//		printf("t=%.2f, %lld, microseconds);
 
-	m_context_time += context_microseconds;
+		context_time += context_microseconds;
+		if (env == m_env) {
+			m_env_restores++;
+			m_env_restore_time += context_microseconds;
+		}
+	}
 
 	// For discounting purposes
 	float g = 1.0;
 	traj_return = 0.0;
+	first_reward = 0;
 	game_ended = false;
 	Action a;
 
@@ -410,6 +781,10 @@ int SearchTree::simulate_game(ALEState & state, Action act, int num_steps,
 //	std::chrono::steady_clock::time_point start =
 //			std::chrono::steady_clock::now();
 
+	PerfSample perf_start;
+	bool count_perf = (m_perf_sections && env == m_env);
+	if (count_perf)
+		m_perf->read(perf_start);
 	auto start = std::chrono::high_resolution_clock::now();
 
 	for (i = 0; i < num_steps; i++) {
@@ -417,25 +792,26 @@ int SearchTree::simulate_game(ALEState & state, Action act, int num_steps,
 			a = choice(&available_actions);
 
 		// Move state forward using action a
-		m_env->set_player_B(m_player_B);
+		env->set_player_B(m_player_B);
 		reward_t curr_reward;
 		if (m_player_B)
-			curr_reward = m_env->oneStepAct(PLAYER_A_NOOP, a);
+			curr_reward = env->oneStepAct(PLAYER_A_NOOP, a);
 		else
-			curr_reward = m_env->oneStepAct(a, PLAYER_B_NOOP);
+			curr_reward = env->oneStepAct(a, PLAYER_B_NOOP);
 
-		game_ended = m_env->isTerminal();
+		game_ended = env->isTerminal();
 
-		return_t r = normalize_rewards ? normalize(curr_reward) : curr_reward;
+		if (first_reward == 0)
+			first_reward = curr_reward;
 
 		// Add curr_reward to the trajectory return
 		if (discount_return) {
-			traj_return += r * g;
+			traj_return += curr_reward * g;
 			// Update the discount factor every sim_steps_per_ndoe
 			if ((i + 1) % sim_steps_per_node == 0)
 				g *= discount_factor;
 		} else
-			traj_return += r;
+			traj_return += curr_reward;
 
 		// Early exit if we reach termination
 		if (game_ended) {
@@ -457,16 +833,174 @@ int SearchTree::simulate_game(ALEState & state, Action act, int num_steps,
 			std::chrono::microseconds>(elapsed).count();
 //	printf("t=%.2f, %lld, microseconds);
 
-	m_emulation_time += microseconds;
-	m_total_simulation_steps += i;
+	emulation_time += microseconds;
+	if (count_perf) {
+		PerfSample perf_end;
+		m_perf->read(perf_end);
+		m_emulation_counters.add_delta(perf_start, perf_end);
+	}
 
 	// Save the result
-	if (save_state)
-		state = m_env->cloneState();
+	if (save_state) {
+		TRACE_SPAN("cloneState");
+		state = env->cloneState();
+	}
+	if (env == m_env)
+		m_loaded_state = (save_state ? &state : NULL);
 
 	return i;
 }
 
+void SearchTree::load_state(StellaEnvironment* env, ALEState& state) {
+	if (env == m_env && m_loaded_state == &state) {
+		m_skipped_restores++;
+		return;
+	}
+
+	TRACE_SPAN("restoreState");
+	auto start = std::chrono::high_resolution_clock::now();
+	env->restoreState(state);
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	long long microseconds = std::chrono::duration_cast<
+			std::chrono::microseconds>(elapsed).count();
+
+	if (env == m_env) {
+		m_context_time += microseconds;
+		m_env_restores++;
+		m_env_restore_time += microseconds;
+		// Not tracked: state may not outlive the caller
+		m_loaded_state = NULL;
+	}
+}
+
+TreeNode* SearchTree::prepare_child(TreeNode* parent, Action act,
+		int num_steps) {
+	TreeNode* child = new TreeNode(parent, parent->state, NULL, act,
+			num_steps);
+
+	SimulationRequest request;
+	request.state = &child->state;
+	request.act = act;
+	request.num_steps = num_steps;
+	m_pending_children.push_back(child);
+	m_pending_requests.push_back(request);
+
+	// Draw the prediction error now, so that the random sequence is the
+	// same as when children are simulated one by one.
+	BatchScratch scratch;
+	scratch.act = act;
+	scratch.num_steps = num_steps;
+	if (erroneous_prediction) {
+		pair<Action, int> rnd = randomizeAction(act, num_steps);
+		scratch.act = rnd.first;
+		scratch.num_steps = rnd.second;
+	}
+	m_pending_scratch.push_back(scratch);
+
+	return child;
+}
+
+void SearchTree::simulate_children() {
+	if (m_pending_children.empty()) {
+		return;
+	}
+
+	run_batch(m_pending_requests, m_pending_scratch);
+
+	for (size_t i = 0; i < m_pending_children.size(); ++i) {
+		TreeNode* node = m_pending_children[i];
+		SimulationRequest& r = m_pending_requests[i];
+		node->is_terminal = r.game_ended;
+		node->init(r.simulated_steps, r.traj_return);
+		node->accumulate_reward();
+	}
+	m_pending_children.clear();
+	m_pending_requests.clear();
+	m_pending_scratch.clear();
+}
+
+void SearchTree::run_batch(std::vector<SimulationRequest>& batch,
+		std::vector<BatchScratch>& scratch) {
+	if (batch.empty()) {
+		return;
+	}
+
+	EmulatorPool::Job job =
+			[this, &batch, &scratch](size_t i, StellaEnvironment* env) {
+				SimulationRequest& r = batch[i];
+				BatchScratch& s = scratch[i];
+				s.context_time = 0;
+				s.emulation_time = 0;
+				r.simulated_steps = simulate_on(env, *r.state, s.act,
+						s.num_steps, r.traj_return, s.first_reward,
+						r.game_ended, false, true, s.context_time,
+						s.emulation_time);
+			};
+
+	if (m_process_pool != NULL && batch.size() > 1) {
+		auto start = std::chrono::high_resolution_clock::now();
+		run_on_processes(batch, scratch);
+		auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_parallel_time += std::chrono::duration_cast<
+				std::chrono::microseconds>(elapsed).count();
+	} else if (m_emulator_pool != NULL && batch.size() > 1) {
+		auto start = std::chrono::high_resolution_clock::now();
+		m_emulator_pool->run(batch.size(), job);
+		auto elapsed = std::chrono::high_resolution_clock::now() - start;
+		m_parallel_time += std::chrono::duration_cast<
+				std::chrono::microseconds>(elapsed).count();
+	} else {
+		for (size_t i = 0; i < batch.size(); ++i) {
+			job(i, m_env);
+		}
+	}
+
+	// Merge in request order: reward normalization and the counters see
+	// the requests in the same order as a serial simulation.
+	for (size_t i = 0; i < batch.size(); ++i) {
+		m_context_time += scratch[i].context_time;
+		m_emulation_time += scratch[i].emulation_time;
+		m_total_simulation_steps += batch[i].simulated_steps;
+
+		if (normalize_rewards)
+			batch[i].traj_return = normalize_return(batch[i].traj_return,
+					scratch[i].first_reward);
+	}
+}
+
+void SearchTree::run_on_processes(std::vector<SimulationRequest>& batch,
+		std::vector<BatchScratch>& scratch) {
+	m_process_batch.resize(batch.size());
+	for (size_t i = 0; i < batch.size(); ++i) {
+		ProcessEmulatorPool::Expansion& e = m_process_batch[i];
+		e.state = batch[i].state;
+		e.act = scratch[i].act;
+		e.num_steps = scratch[i].num_steps;
+		e.player_B = m_player_B;
+	}
+	m_process_pool->run(m_process_batch);
+	for (size_t i = 0; i < batch.size(); ++i) {
+		ProcessEmulatorPool::Expansion& e = m_process_batch[i];
+		if (!e.done) {
+			// Too large for the workers: simulated here instead
+			scratch[i].context_time = 0;
+			scratch[i].emulation_time = 0;
+			batch[i].simulated_steps = simulate_on(m_env, *batch[i].state,
+					scratch[i].act, scratch[i].num_steps,
+					batch[i].traj_return, scratch[i].first_reward,
+					batch[i].game_ended, false, true,
+					scratch[i].context_time, scratch[i].emulation_time);
+			continue;
+		}
+		batch[i].simulated_steps = e.simulated_steps;
+		batch[i].traj_return = e.traj_return;
+		batch[i].game_ended = e.game_ended;
+		scratch[i].first_reward = e.first_reward;
+		scratch[i].context_time = e.context_time;
+		scratch[i].emulation_time = e.emulation_time;
+	}
+}
+
 // Simulate game randomly using a particular action_set.
 int SearchTree::simulate_game_random(ALEState & state, ActionVect&action_set,
 		int num_steps, return_t &traj_return, bool &game_ended,
@@ -513,6 +1047,18 @@ return_t SearchTree::normalize(reward_t reward) {
 
 }
 
+return_t SearchTree::normalize_return(return_t traj_return,
+		reward_t first_reward) {
+	if (first_reward == 0)
+		return traj_return;
+	else {
+		// Set reward magnitude to first observed non-zero reward
+		if (reward_magnitude == 0)
+			reward_magnitude = abs(first_reward);
+		return traj_return / reward_magnitude;
+	}
+}
+
 int SearchTree::num_nodes() {
 	if (p_root == NULL)
 		return 0;
@@ -548,6 +1094,88 @@ long SearchTree::num_simulation_steps() {
 	return s;
 }
 
+void SearchTree::begin_decision(bool keep_section_counters,
+		std::chrono::steady_clock::time_point start) {
+	m_decision_start = start;
+	m_planning_deadline = m_decision_start
+			+ std::chrono::milliseconds(m_max_planning_ms);
+	m_timed_out = false;
+	if (!keep_section_counters) {
+		m_emulation_counters.clear();
+		m_feature_counters.clear();
+	}
+}
+
+bool SearchTree::out_of_time() {
+	if (m_stop->load(std::memory_order_relaxed)) {
+		m_timed_out = true;
+		return true;
+	}
+	if (m_max_planning_ms <= 0) {
+		return false;
+	}
+	if (std::chrono::steady_clock::now() < m_planning_deadline) {
+		return false;
+	}
+	m_timed_out = true;
+	return true;
+}
+
+void SearchTree::end_decision() {
+	// The tree is final: decision_memory() measures it again
+	m_decision_memory_valid = false;
+
+	// Decisions kept to compute the latency percentiles
+	const size_t window = 100;
+	// Decisions measured with the current budget before changing it again:
+	// fewer than 100 samples have no meaningful p99
+	const unsigned min_samples = 100;
+
+	std::chrono::duration<double, std::milli> latency =
+			std::chrono::steady_clock::now() - m_decision_start;
+	m_latencies.push_back(latency.count());
+	if (m_latencies.size() > window) {
+		m_latencies.pop_front();
+	}
+	m_decisions_since_rescale++;
+
+	std::vector<double> sorted(m_latencies.begin(), m_latencies.end());
+	std::sort(sorted.begin(), sorted.end());
+	m_latency_p50 = sorted[(sorted.size() - 1) / 2];
+	m_latency_p99 = sorted[(sorted.size() - 1) * 99 / 100];
+
+	if (m_planning_slo_ms <= 0 || m_decisions_since_rescale < min_samples) {
+		return;
+	}
+	// Only the decisions planned with the current budget say whether it fits
+	size_t n = std::min<size_t>(m_decisions_since_rescale, sorted.size());
+	std::vector<double> recent(m_latencies.end() - n, m_latencies.end());
+	std::sort(recent.begin(), recent.end());
+	double p99 = recent[(n - 1) * 99 / 100];
+
+	double scale = m_budget_scale;
+	if (p99 > m_planning_slo_ms) {
+		scale = std::max(0.05, scale * 0.8);
+	} else if (p99 < 0.7 * m_planning_slo_ms) {
+		scale = std::min(1.0, scale * 1.1);
+	}
+	if (scale != m_budget_scale) {
+		LOG(LOG_INFO,
+				"Latency p99 %.1f ms (SLO %d ms): budget scale %.2f -> %.2f\n",
+				p99, m_planning_slo_ms, m_budget_scale, scale);
+		m_budget_scale = scale;
+		m_decisions_since_rescale = 0;
+		apply_budget_scale();
+	}
+}
+
+void SearchTree::apply_budget_scale() {
+	if (m_step_budget != -1) {
+		max_sim_steps_per_frame = std::max(sim_steps_per_node,
+				(int) (m_step_budget * m_budget_scale));
+	}
+}
+
 void SearchTree::print_frame_data(int frame_number, float elapsed,
 		Action curr_action, std::ostream& output) {
 	output << "frame=" << frame_number;
@@ -560,11 +1188,130 @@ void SearchTree::print_frame_data(int frame_number, float elapsed,
 	output << ",elapsed=" << elapsed;
 	output << ",total_simulation_steps=" << m_total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
+	print_profile_data(output);
 	m_rom_settings->print(output);
 	output << std::endl;
 
 }
 
+void SearchTree::fill_telemetry(TelemetryRecord& record) {
+	record.total_simulation_steps = m_total_simulation_steps;
+	record.emulation_time = m_emulation_time;
+	record.context_time = m_context_time;
+	record.feature_time = m_feature_time;
+	record.teardown_time = m_teardown_time;
+	const MemoryUsage& memory = decision_memory();
+	record.tree_bytes = memory.tree();
+	record.state_bytes = memory.states;
+	record.node_bytes = memory.nodes;
+	record.child_bytes = memory.children;
+	record.action_bytes = memory.actions;
+	record.novelty_bytes = memory.novelty;
+	record.peak_tree_bytes = m_peak_tree_bytes;
+	record.peak_memory_bytes = m_peak_memory_bytes;
+	record.latency_ms = m_latencies.empty() ? 0 : m_latencies.back();
+	record.expanded = expanded_nodes();
+	record.generated = generated_nodes();
+	record.pruned = pruned();
+	record.jasd_pruned = jasd_pruned();
+	record.depth = max_depth();
+	record.tree_size = num_nodes();
+	record.branch_reward = get_root_value();
+	record.evicted_nodes = m_evicted_nodes;
+	record.flags = 0;
+	if (m_timed_out)
+		record.flags |= TELEMETRY_TIMED_OUT;
+	record.cycles = m_decision_counters.count[PERF_CYCLES];
+	record.instructions = m_decision_counters.count[PERF_INSTRUCTIONS];
+	record.l1d_misses = m_decision_counters.count[PERF_L1D_MISSES];
+	record.llc_misses = m_decision_counters.count[PERF_LLC_MISSES];
+	record.branch_misses = m_decision_counters.count[PERF_BRANCH_MISSES];
+	record.emulation_cycles = m_emulation_counters.count[PERF_CYCLES];
+	record.feature_cycles = m_feature_counters.count[PERF_CYCLES];
+	if (m_perf != NULL) {
+		record.flags |= m_perf->available_mask() << TELEMETRY_PERF_SHIFT;
+		if (m_perf_sections)
+			record.flags |= TELEMETRY_PERF_SECTIONS;
+	}
+}
+
+void SearchTree::print_profile_data(std::ostream& output) {
+	output << ",context_time=" << m_context_time;
+	output << ",teardown_time=" << m_teardown_time;
+	if (m_reclaimer != NULL) {
+		output << ",deferred_teardown_time=" << m_reclaimer->reclaimed_time();
+		output << ",deferred_teardown_nodes="
+				<< m_reclaimer->reclaimed_nodes();
+	}
+	if (m_process_pool != NULL) {
+		output << ",emulator_processes=" << m_process_pool->size();
+	}
+	if (m_emulator_pool != NULL) {
+		output << ",emulator_threads=" << m_emulator_pool->size();
+	}
+	if (m_process_pool != NULL || m_emulator_pool != NULL) {
+		output << ",parallel_simulation_time=" << m_parallel_time;
+	}
+	output << ",skipped_restores=" << m_skipped_restores;
+	output << ",skipped_clones=" << m_skipped_clones;
+	// Estimated from the average cost of the restores actually done
+	long long saved_context_time = 0;
+	if (m_env_restores > 0)
+		saved_context_time = m_env_restore_time * m_skipped_restores
+				/ m_env_restores;
+	output << ",saved_context_time=" << saved_context_time;
+	if (m_feature_time > 0)
+		output << ",feature_time=" << m_feature_time;
+	if (m_max_planning_ms > 0) {
+		output << ",timed_out=" << m_timed_out;
+	}
+	if (m_planning_slo_ms > 0) {
+		output << ",latency_p50=" << m_latency_p50;
+		output << ",latency_p99=" << m_latency_p99;
+		output << ",budget_scale=" << m_budget_scale;
+	}
+	if (m_speculation_hits + m_speculation_misses > 0) {
+		output << ",speculation_hits=" << m_speculation_hits;
+		output << ",speculation_misses=" << m_speculation_misses;
+		output << ",speculation_time=" << m_speculation_time;
+	}
+	if (m_perf != NULL && m_perf->available()) {
+		// Per generated node, to compare configurations
+		double nodes = std::max(1u, generated_nodes());
+		for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+			if (m_perf->available_mask() & (1 << e))
+				output << "," << PerfCounters::event_name(e) << "_per_node="
+						<< m_decision_counters.count[e] / nodes;
+		}
+		uint64_t cycles = m_decision_counters.count[PERF_CYCLES];
+		if (cycles > 0) {
+			output << ",ipc="
+					<< (double) m_decision_counters.count[PERF_INSTRUCTIONS]
+							/ cycles;
+			if (m_perf_sections) {
+				output << ",emulation_cycle_share="
+						<< (double) m_emulation_counters.count[PERF_CYCLES]
+								/ cycles;
+				output << ",feature_cycle_share="
+						<< (double) m_feature_counters.count[PERF_CYCLES]
+								/ cycles;
+			}
+		}
+	}
+	const MemoryUsage& memory = decision_memory();
+	output << ",tree_bytes=" << memory.tree();
+	output << ",state_bytes=" << memory.states;
+	output << ",node_bytes=" << memory.nodes;
+	output << ",child_bytes=" << memory.children;
+	output << ",action_bytes=" << memory.actions;
+	output << ",novelty_bytes=" << memory.novelty;
+	output << ",peak_tree_bytes=" << m_peak_tree_bytes;
+	output << ",peak_memory_bytes=" << m_peak_memory_bytes;
+	output << ",evicted_nodes=" << m_evicted_nodes;
+	output << ",evicted_subtrees=" << m_evicted_subtrees;
+	output << ",total_evicted_nodes=" << m_total_evicted_nodes;
+}
+
 void SearchTree::getJunkActionSequence(int frame_number) {
 	if (action_sequence_detection) {
 //		int agent_frame = frame_number / 5;
@@ -585,6 +1332,7 @@ void SearchTree::getJunkActionSequence(int frame_number) {
 //		}
 
 //		if (longest_junk_sequence >= current_junk_length) {
+		TRACE_SPAN("dasd_learning");
 		dasd->learnDominatedActionSequences(this, dasd_sequence_length);
 //		}
 
@@ -634,7 +1382,15 @@ int SearchTree::getDetectedUsedActionsSize() {
 	}
 }
 
-pair<Action, int> SearchTree::randomizeAction(Action a, int duration) {
+pair<Action, int> SearchTree::randomizeAction(Action a, int duration,
+		std::mt19937* rng) {
+	auto draw_error = [&]() {
+		if (rng != NULL)
+			return std::uniform_real_distribution<double>(0.0, 1.0)(*rng)
+					< prediction_error_rate;
+		return rand() < prediction_error_rate * (double) RAND_MAX;
+	};
+
 	int x_axis;
 	int y_axis;
 	bool fire;
@@ -671,7 +1427,7 @@ pair<Action, int> SearchTree::randomizeAction(Action a, int duration) {
 		fire = true;
 	}
 
-	if (rand() < prediction_error_rate * (double) RAND_MAX) {
+	if (draw_error()) {
 		vector<pair<int, int>> errors;
 		if (x_axis <= 0) {
 			errors.push_back(pair<int, int>(1, 0));
@@ -685,12 +1441,16 @@ pair<Action, int> SearchTree::randomizeAction(Action a, int duration) {
 		if (y_axis >= 0) {
 			errors.push_back(pair<int, int>(0, -1));
 		}
-		pair<int, int> err = choice(&errors);
+		pair<int, int> err;
+		if (rng != NULL)
+			err = errors[(*rng)() % errors.size()];
+		else
+			err = choice(&errors);
 		x_axis += err.first;
 		y_axis += err.second;
 	}
 
-	if (rand() < prediction_error_rate * (double) RAND_MAX) {
+	if (draw_error()) {
 		fire = !fire;
 	}
 
@@ -726,8 +1486,8 @@ pair<Action, int> SearchTree::randomizeAction(Action a, int duration) {
 		}
 	}
 
-	if (rand() < prediction_error_rate * RAND_MAX) {
-		if (rand() % 2) {
+	if (draw_error()) {
+		if ((rng != NULL ? (*rng)() : rand()) % 2) {
 			dur += 1;
 		} else {
 			dur -= 1;
@@ -23,13 +23,44 @@
 #include "../environment/ale_state.hpp"
 #include "../environment/stella_environment.hpp"
 #include "Settings.hxx"
+#include "ProcessEmulatorPool.hpp"
+#include "Telemetry.hpp"
+#include "Tracing.hpp"
+#include "Logger.hpp"
+#include "PerfCounters.hpp"
 #include <fstream>
 #include <limits>
+#include <random>
+#include <chrono>
+#include <deque>
+#include <atomic>
 
 //#include "ActionSequenceDetection.hpp"
 
 class SearchAgent;
 class DominatedActionSequenceDetection;
+class TreeReclaimer;
+class EmulatorPool;
+
+// Bytes held by a search tree and by the novelty tables of its search, as
+// allocated on the heap (see SearchTree::memory_usage())
+struct MemoryUsage {
+	size_t states; // serialized emulator states (estimated, see count_node)
+	size_t nodes; // TreeNode structs, ALEState objects included
+	size_t children; // child pointer arrays
+	size_t actions; // available_actions copies
+	size_t novelty; // novelty tables
+
+	MemoryUsage() :
+			states(0), nodes(0), children(0), actions(0), novelty(0) {
+	}
+	size_t tree() const {
+		return states + nodes + children + actions;
+	}
+	size_t total() const {
+		return tree() + novelty;
+	}
+};
 
 class SearchTree {
 	/* *************************************************************************
@@ -43,6 +74,13 @@ public:
 	SearchTree(RomSettings *, Settings &, ActionVect &,
 			StellaEnvironment* _env);
 
+	/* *********************************************************************
+	 Worker tree sharing the configuration and the DASD of parent. Reads
+	 no setting and prints nothing; has no reclaimer, pool, latency SLO or
+	 memory budget of its own.
+	 ******************************************************************* */
+	SearchTree(const SearchTree& parent, StellaEnvironment* _env);
+
 	/* *********************************************************************
 	 Destructor
 	 ******************************************************************* */
@@ -109,8 +147,26 @@ public:
 	int simulate_game_err(ALEState & state, Action act, int num_steps,
 			return_t &traj_return, bool &game_ended, bool discount_return =
 					false, bool save_state = true);
+
+	/** A (state, action, steps) request of a batch (see prepare_child()).
+	 *  The state is simulated in place and holds the resulting state
+	 *  afterwards. */
+	struct SimulationRequest {
+		ALEState* state;
+		Action act;
+		int num_steps;
+
+		// Results
+		int simulated_steps;
+		return_t traj_return; // normalized if normalize_rewards is set
+		bool game_ended;
+	};
+
 	/** Normalizes a reward using the first non-zero reward's magnitude */
 	return_t normalize(reward_t reward);
+	/** Normalizes the return of a whole simulation; first_reward is the
+	 *  first non-zero reward seen during that simulation */
+	return_t normalize_return(return_t traj_return, reward_t first_reward);
 	virtual unsigned max_depth() {
 		return m_max_depth;
 	}
@@ -145,12 +201,134 @@ public:
 	void set_available_actions(ActionVect acts) {
 		available_actions = acts;
 	}
+	/** Worker emulators used to simulate the children of a node
+	 *  concurrently; NULL (the default) simulates them on m_env. */
+	void set_emulator_pool(EmulatorPool* pool) {
+		m_emulator_pool = pool;
+	}
+	/** Worker processes used to simulate the children of a node; takes
+	 *  precedence over the emulator pool for that. NULL disables them. */
+	void set_process_pool(ProcessEmulatorPool* pool) {
+		m_process_pool = pool;
+	}
+	/** Hardware counters of the search thread. With sections, emulation
+	 *  and feature extraction on m_env are also counted apart. NULL (the
+	 *  default) disables them. */
+	void set_perf_counters(PerfCounters* perf, bool sections) {
+		m_perf = perf;
+		m_perf_sections = (perf != NULL && sections);
+	}
+	/** Counters of the last decision, reported per node in the traces */
+	void record_decision_counters(const PerfSample& sample) {
+		m_decision_counters = sample;
+	}
+	/** Makes the tree simulate on another emulator, e.g. to search on a
+	 *  background thread while m_env plays the game. */
+	void set_environment(StellaEnvironment* env) {
+		m_env = env;
+		m_loaded_state = NULL;
+	}
+	/** Accounts a speculative search of the next root, done while the
+	 *  previous action was being executed. hit tells whether the real
+	 *  state matched the predicted one. */
+	void record_speculation(bool hit, long long microseconds) {
+		if (hit)
+			m_speculation_hits++;
+		else
+			m_speculation_misses++;
+		m_speculation_time = microseconds;
+	}
+	/** Forgets which state m_env holds. Call it after using m_env outside
+	 *  of the tree. */
+	void forget_loaded_state() {
+		m_loaded_state = NULL;
+	}
 	/** Returns the number of simulation steps used since the last call to
 	 *  this function. */
 	long num_simulation_steps();
 
+	/** Overrides max_sim_steps_per_frame (-1: none) */
+	void set_step_budget(int steps) {
+		m_step_budget = steps;
+		apply_budget_scale();
+	}
+	/** Overrides max_planning_ms (<= 0: none) */
+	void set_planning_time(int milliseconds) {
+		m_max_planning_ms = milliseconds;
+	}
+
+	/** Starts the wall-clock budget (max_planning_ms) of a decision. Call
+	 *  it before build() or update_tree(). keep_section_counters carries
+	 *  over the emulation and feature counters of a speculative search of
+	 *  the same decision. start is when the decision was asked for, if the
+	 *  agent had to wait before it could plan. */
+	void begin_decision(bool keep_section_counters = false,
+			std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now());
+	/** Makes the running search, and the worker trees sharing its flag,
+	 *  stop at their next budget check. Safe from any thread; stays set
+	 *  until clear_stop(). */
+	void request_stop() {
+		m_stop->store(true);
+	}
+	void clear_stop() {
+		m_stop->store(false);
+	}
+	/** Records the latency of the decision started by begin_decision()
+	 *  and, when a latency SLO is set, adapts the step budget to it */
+	void end_decision();
+
 	virtual void print_frame_data(int frame_number, float elapsed,
 			Action curr_action, std::ostream& output);
+	/** Fills the search counters of a telemetry record; the caller sets
+	 *  the episode, frame, action and elapsed time */
+	void fill_telemetry(TelemetryRecord& record);
+
+	/** Nodes pruned by novelty (or duplicate) pruning on this frame */
+	virtual int pruned() const {
+		return 0;
+	}
+	/** Nodes pruned by dominated action sequence detection */
+	virtual int jasd_pruned() const {
+		return m_jasd_pruned_nodes;
+	}
+
+	/* *********************************************************************
+	 Evicts subtrees until the tree fits in tree_memory_budget. Subtrees
+	 below duplicate or terminal nodes go first, then the deepest and
+	 least valuable ones. The root and its children are always kept.
+	 ******************************************************************* */
+	void enforce_memory_budget();
+
+	/** Bytes held by the current tree, novelty tables excluded */
+	size_t tree_bytes();
+
+	/** Bytes held by the current tree and the novelty tables, by kind.
+	 *  Walks the whole tree and updates the peaks below. */
+	MemoryUsage memory_usage();
+	/** memory_usage() of the tree of the last decision, measured on the
+	 *  first call after end_decision() and shared by the trace and the
+	 *  telemetry */
+	const MemoryUsage& decision_memory();
+	/** Highest tree_bytes() and memory_usage().total() seen so far */
+	size_t peak_tree_bytes() const {
+		return m_peak_tree_bytes;
+	}
+	size_t peak_memory_bytes() const {
+		return m_peak_memory_bytes;
+	}
+
+	/** Microseconds spent emulating, restoring states and extracting
+	 *  novelty features since the tree was created */
+	long long emulation_time() const {
+		return m_emulation_time;
+	}
+	long long context_time() const {
+		return m_context_time;
+	}
+	long long feature_time() const {
+		return m_feature_time;
+	}
 
 	void getJunkActionSequence(int frame_number);
 	void saveUsedAction(int frame_number, Action action);
@@ -166,6 +344,88 @@ protected:
 	 ******************************************************************* */
 	void delete_branch(TreeNode* node);
 
+	/* *********************************************************************
+	 Disposes of a detached branch. Hands it to the background reclaimer
+	 when one is enabled, otherwise deletes it right away.
+	 ******************************************************************* */
+	void discard_branch(TreeNode* node);
+
+	/** Sets the counters, timers and pools of a new tree */
+	void init_state();
+
+	/** Bytes held by a single node */
+	size_t node_bytes(TreeNode* node);
+	/** Bytes held by a subtree; also counts its nodes */
+	size_t subtree_bytes(TreeNode* node, unsigned& nodes);
+	/** Adds the bytes held by a node, or by its whole subtree, to usage */
+	void count_node(TreeNode* node, MemoryUsage& usage);
+	void count_subtree(TreeNode* node, MemoryUsage& usage, unsigned& nodes);
+	/** Bytes held by the novelty tables of the search (0 if none) */
+	virtual size_t novelty_bytes() const {
+		return 0;
+	}
+	/** Drops all the children of a node, turning it back into a leaf.
+	 *  Returns the number of bytes released. */
+	size_t collapse_node(TreeNode* node);
+
+	/** True once num_simulated_steps reaches the step budget or the
+	 *  wall-clock budget of the decision runs out */
+	bool budget_spent(int num_simulated_steps) {
+		return num_simulated_steps >= max_sim_steps_per_frame || out_of_time();
+	}
+	/** True once max_planning_ms have passed since begin_decision(), or
+	 *  once request_stop() was called. Costs one clock read, next to the
+	 *  frames emulated between two checks. */
+	bool out_of_time();
+
+	/** Sets the search budget to the configured one times m_budget_scale */
+	virtual void apply_budget_scale();
+
+	/** Appends the profiling counters shared by all trees to a frame trace */
+	virtual void print_profile_data(std::ostream& output);
+
+	/** Simulation core shared by simulate_game() and the emulator pool.
+	 *  Runs on the given emulator and, unless env is m_env, touches no
+	 *  member that changes during a search, so it can be called from a
+	 *  worker thread as long as act is not RANDOM. traj_return is not
+	 *  normalized; first_reward receives the first non-zero reward so that
+	 *  the caller can do it. */
+	int simulate_on(StellaEnvironment* env, ALEState & state, Action act,
+			int num_steps, return_t &traj_return, reward_t &first_reward,
+			bool &game_ended, bool discount_return, bool save_state,
+			long long &context_time, long long &emulation_time);
+
+	/** Makes env hold state, e.g. to render its screen. On m_env the
+	 *  restore is skipped when m_env already holds that state. */
+	void load_state(StellaEnvironment* env, ALEState& state);
+
+	/** Creates a child of parent that is simulated by the next call to
+	 *  simulate_children(). The child is not attached to parent. */
+	TreeNode* prepare_child(TreeNode* parent, Action act, int num_steps);
+
+	/** Simulates every child created by prepare_child() since the last
+	 *  call as one batch, concurrently when an emulator pool is set. The
+	 *  children, the counters and the random sequence end up exactly as if
+	 *  they had been created one after the other. */
+	void simulate_children();
+
+	// What run_batch() actually runs for a request
+	struct BatchScratch {
+		Action act; // action actually simulated (see erroneous_prediction)
+		int num_steps;
+		reward_t first_reward;
+		long long context_time;
+		long long emulation_time;
+	};
+
+	/** Runs a batch whose prediction errors are already drawn in scratch,
+	 *  then merges the counters and normalizes the returns in order */
+	void run_batch(std::vector<SimulationRequest>& batch,
+			std::vector<BatchScratch>& scratch);
+	/** The simulation part of run_batch() on the worker processes */
+	void run_on_processes(std::vector<SimulationRequest>& batch,
+			std::vector<BatchScratch>& scratch);
+
 	/** Returns true if this node has a sibling with the same resulting state;
 	 *  also sets the node's duplicate flag to true in that case. */
 	bool test_duplicate(TreeNode * node);
@@ -173,7 +433,10 @@ protected:
 //	std::vector<bool> getUsefulActions(vector<Action> previousActions);
 	std::vector<Action> getPreviousActions(const TreeNode* node,
 			int seqLength) const;
-	std::pair<Action, int> randomizeAction(Action a, int duration);
+	/** Applies the prediction error to an action. Draws from rng when one
+	 *  is given, so that worker threads do not share rand(). */
+	std::pair<Action, int> randomizeAction(Action a, int duration,
+			std::mt19937* rng = NULL);
 
 protected:
 
@@ -222,6 +485,8 @@ protected:
 	unsigned int m_total_simulation_steps; //
 	long long m_emulation_time;
 	long long m_context_time;
+	// Spent computing novelty features, rendering included
+	long long m_feature_time;
 
 	// Action Sequence Detection
 	bool action_sequence_detection; // true if it applies ASD.
@@ -231,6 +496,7 @@ protected:
 	int decision_frame_function;
 
 	DominatedActionSequenceDetection* dasd;
+	bool m_owns_dasd; // false on worker trees, which share the parent's
 
 //	int current_junk_length;
 	vector<Action> trajectory;
@@ -242,6 +508,79 @@ protected:
 
 	bool erroneous_prediction;
 	float prediction_error_rate;
+
+	// Frees discarded subtrees off the critical path (NULL if disabled)
+	TreeReclaimer* m_reclaimer;
+	// Microseconds spent tearing down discarded subtrees on the search thread
+	long long m_teardown_time;
+
+	// Memory budget for the tree in bytes (0 if unbounded)
+	size_t m_memory_budget;
+	// Heap bytes of a serialized state, estimated from the first node we
+	// see (they all have the same size; the string itself is private to
+	// ALEState, so the allocator cannot be asked)
+	size_t m_state_bytes;
+	// Size of the tree after the last call to enforce_memory_budget()
+	size_t m_tree_bytes;
+	size_t m_peak_tree_bytes;
+	size_t m_peak_memory_bytes;
+	MemoryUsage m_decision_memory;
+	bool m_decision_memory_valid;
+	unsigned m_evicted_nodes; // nodes evicted on this frame
+	unsigned m_evicted_subtrees; // subtrees evicted on this frame
+	unsigned long long m_total_evicted_nodes;
+
+	// Children waiting to be simulated by simulate_children()
+	NodeList m_pending_children;
+	std::vector<SimulationRequest> m_pending_requests;
+	std::vector<BatchScratch> m_pending_scratch;
+
+	// State object whose content m_env holds (NULL if unknown). Every path
+	// that deletes nodes or uses m_env directly resets it.
+	const ALEState* m_loaded_state;
+	unsigned long long m_env_restores; // restores actually done on m_env
+	long long m_env_restore_time; // microseconds spent on them
+	unsigned long long m_skipped_restores;
+	unsigned long long m_skipped_clones;
+
+	// Wall-clock budget of a decision in milliseconds (<= 0: none)
+	int m_max_planning_ms;
+	std::chrono::steady_clock::time_point m_decision_start;
+	std::chrono::steady_clock::time_point m_planning_deadline;
+	// Set by request_stop(); worker trees point to their parent's flag
+	std::atomic<bool> m_stop_flag;
+	std::atomic<bool>* m_stop;
+	// Hardware counters (NULL if disabled); sections are only counted on
+	// m_env, which the counters' thread drives
+	PerfCounters* m_perf;
+	bool m_perf_sections;
+	PerfSample m_decision_counters;
+	PerfSample m_emulation_counters; // on this decision
+	PerfSample m_feature_counters;
+	// Set when the search of this decision stopped for lack of time
+	std::atomic<bool> m_timed_out;
+	// Target p99 decision latency in milliseconds (<= 0: no adaptation)
+	int m_planning_slo_ms;
+	// Step budget from the settings, scaled by m_budget_scale
+	int m_step_budget;
+	double m_budget_scale;
+	// Latencies of the last decisions, in milliseconds
+	std::deque<double> m_latencies;
+	unsigned m_decisions_since_rescale;
+	double m_latency_p50;
+	double m_latency_p99;
+
+	// Speculative searches of the next root (see SearchAgent)
+	unsigned m_speculation_hits;
+	unsigned m_speculation_misses;
+	long long m_speculation_time; // microseconds of the last one
+
+	ProcessEmulatorPool* m_process_pool;
+	std::vector<ProcessEmulatorPool::Expansion> m_process_batch;
+
+	EmulatorPool* m_emulator_pool;
+	// Wall-clock microseconds spent waiting for the emulator pool
+	long long m_parallel_time;
 };
 
 #endif // __SEARCH_TREE_HPP__
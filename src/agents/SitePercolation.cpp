@@ -87,6 +87,24 @@ int SitePercolation::expand_node(TreeNode* curr_node) {
 		}
 	}
 
+	// Simulate the children of a leaf as one batch
+	NodeList generated;
+	if (leaf_node) {
+		generated.resize(num_actions);
+		for (int a = 0; a < num_actions; a++) {
+			Action act = curr_node->available_actions[a];
+			if (action_sequence_detection && curr_node != p_root
+					&& !isUsefulAction[act]) {
+				generated[a] = new TreeNode(curr_node, curr_node->state, this,
+						act, 0);
+			} else {
+				generated[a] = prepare_child(curr_node, act,
+						sim_steps_per_node);
+			}
+		}
+		simulate_children();
+	}
+
 	for (int a = 0; a < num_actions; a++) {
 		Action act = curr_node->available_actions[a];
 
@@ -98,8 +116,7 @@ int SitePercolation::expand_node(TreeNode* curr_node) {
 				if (curr_node != p_root) {
 					if (!isUsefulAction[act]) {
 						m_jasd_pruned_nodes++;
-						TreeNode * child = new TreeNode(curr_node,
-								curr_node->state, this, act, 0);
+						TreeNode * child = generated[a];
 						curr_node->v_children[a] = child;
 						child->is_terminal = true;
 						continue;
@@ -108,8 +125,7 @@ int SitePercolation::expand_node(TreeNode* curr_node) {
 			}
 
 			m_generated_nodes++;
-			child = new TreeNode(curr_node, curr_node->state, this, act,
-					sim_steps_per_node);
+			child = generated[a];
 			child->fn = calc_fn(child->state.getRAM(),
 					child->accumulated_reward);
 //			printf("child generated %d\n", child->fn);
@@ -200,14 +216,14 @@ void SitePercolation::expand_tree(TreeNode* start_node) {
 
 	do {
 
-		std::cout << "# Pivots: " << pivots.size() << std::endl;
-		std::cout << "First pivot reward: " << pivots.front()->node_reward
-				<< std::endl;
+		LOG(LOG_TRACE, "# Pivots: %zu\n", pivots.size());
+		LOG(LOG_TRACE, "First pivot reward: %g\n",
+				(double) pivots.front()->node_reward);
 		pivots.front()->m_depth = 0;
 		int steps = expand_node(pivots.front());
 		num_simulated_steps += steps;
 
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
@@ -227,25 +243,26 @@ void SitePercolation::expand_tree(TreeNode* start_node) {
 			steps = expand_node(curr_node);
 			num_simulated_steps += steps;
 			// Stop once we have simulated a maximum number of steps
-			if (num_simulated_steps >= max_sim_steps_per_frame) {
+			if (budget_spent(num_simulated_steps)) {
 				break;
 			}
 
 		}
-		std::cout << "\tExpanded so far: " << m_expanded_nodes << std::endl;
-		std::cout << "\tPruned so far: " << m_pruned_nodes << std::endl;
-		std::cout << "\tGenerated so far: " << m_generated_nodes << std::endl;
+		LOG(LOG_TRACE, "\tExpanded so far: %u\n", m_expanded_nodes);
+		LOG(LOG_TRACE, "\tPruned so far: %u\n", m_pruned_nodes);
+		LOG(LOG_TRACE, "\tGenerated so far: %u\n", m_generated_nodes);
 
 		if (m_q_percolation.empty())
-			std::cout << "Search Space Exhausted!" << std::endl;
+			LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 
 	} while (!pivots.empty());
 
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -361,6 +378,7 @@ void SitePercolation::print_frame_data(int frame_number, float elapsed,
 	output << ",elapsed=" << elapsed;
 	output << ",total_simulation_steps=" << total_simulation_steps;
 	output << ",emulation_time=" << m_emulation_time;
+	print_profile_data(output);
 	m_rom_settings->print(output);
 	output << std::endl;
 }
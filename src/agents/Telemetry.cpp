@@ -0,0 +1,210 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Telemetry.cpp
+ *
+ *  Binary per-decision telemetry of the search agent.
+ **************************************************************************** */
+
+#include "Telemetry.hpp"
+#include "PerfCounters.hpp"
+#include "Constants.h"
+
+#include <cstring>
+
+static const char telemetry_magic[8] = { 'A', 'L', 'E', 'T', 'E', 'L', 'E',
+		'M' };
+
+TelemetryWriter::TelemetryWriter(const std::string& path,
+		size_t records_per_chunk) :
+		m_records_per_chunk(records_per_chunk), m_stop(false) {
+	m_file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+	TelemetryHeader header;
+	memcpy(header.magic, telemetry_magic, sizeof(header.magic));
+	header.version = TELEMETRY_VERSION;
+	header.record_size = sizeof(TelemetryRecord);
+	m_file.write((const char*) &header, sizeof(header));
+	m_chunk.reserve(m_records_per_chunk);
+	m_thread = std::thread(&TelemetryWriter::run, this);
+}
+
+TelemetryWriter::~TelemetryWriter() {
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeup.notify_one();
+	m_thread.join();
+	m_file.close();
+}
+
+void TelemetryWriter::write(const TelemetryRecord& record) {
+	m_chunk.push_back(record);
+	if (m_chunk.size() >= m_records_per_chunk) {
+		flush();
+	}
+}
+
+void TelemetryWriter::flush() {
+	if (m_chunk.empty()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::vector<TelemetryRecord>());
+		m_queue.back().swap(m_chunk);
+	}
+	m_wakeup.notify_one();
+	m_chunk.reserve(m_records_per_chunk);
+}
+
+void TelemetryWriter::run() {
+	std::vector<std::vector<TelemetryRecord> > chunks;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeup.wait(lock, [this] {return m_stop || !m_queue.empty();});
+			if (m_queue.empty() && m_stop) {
+				return;
+			}
+			chunks.swap(m_queue);
+		}
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			m_file.write((const char*) chunks[i].data(),
+					chunks[i].size() * sizeof(TelemetryRecord));
+		}
+		m_file.flush();
+		chunks.clear();
+	}
+}
+
+TelemetryReader::TelemetryReader(const std::string& path) :
+		m_ok(false) {
+	m_file.open(path.c_str(), std::ios::binary);
+	TelemetryHeader header;
+	if (m_file.read((char*) &header, sizeof(header))
+			&& memcmp(header.magic, telemetry_magic, sizeof(header.magic)) == 0
+			&& header.version == TELEMETRY_VERSION
+			&& header.record_size == sizeof(TelemetryRecord)) {
+		m_ok = true;
+	}
+}
+
+bool TelemetryReader::next(TelemetryRecord& record) {
+	// A record cut short by a crash is dropped
+	return m_ok && m_file.read((char*) &record, sizeof(record));
+}
+
+static uint64_t perf_count(const TelemetryRecord& record, int event) {
+	const uint64_t counts[PERF_NUM_EVENTS] = { record.cycles,
+			record.instructions, record.l1d_misses, record.llc_misses,
+			record.branch_misses };
+	return counts[event];
+}
+
+static bool perf_counted(const TelemetryRecord& record, int event) {
+	return (record.flags >> TELEMETRY_PERF_SHIFT) & (1 << event);
+}
+
+static double per_node(const TelemetryRecord& record, uint64_t count) {
+	return (double) count / (record.generated > 0 ? record.generated : 1);
+}
+
+void print_telemetry_record(const TelemetryRecord& record,
+		std::ostream& output) {
+	output << "episode=" << record.episode;
+	output << ",frame=" << record.frame;
+	output << ",expanded=" << record.expanded;
+	output << ",generated=" << record.generated;
+	output << ",pruned=" << record.pruned;
+	output << ",jasd_pruned=" << record.jasd_pruned;
+	output << ",depth_tree=" << record.depth;
+	output << ",tree_size=" << record.tree_size;
+	output << ",best_action=" << action_to_string((Action) record.action);
+	output << ",branch_reward=" << record.branch_reward;
+	output << ",elapsed=" << record.elapsed;
+	output << ",latency=" << record.latency_ms;
+	output << ",total_simulation_steps=" << record.total_simulation_steps;
+	output << ",emulation_time=" << record.emulation_time;
+	output << ",context_time=" << record.context_time;
+	output << ",feature_time=" << record.feature_time;
+	output << ",teardown_time=" << record.teardown_time;
+	output << ",tree_bytes=" << record.tree_bytes;
+	output << ",state_bytes=" << record.state_bytes;
+	output << ",node_bytes=" << record.node_bytes;
+	output << ",child_bytes=" << record.child_bytes;
+	output << ",action_bytes=" << record.action_bytes;
+	output << ",novelty_bytes=" << record.novelty_bytes;
+	output << ",peak_tree_bytes=" << record.peak_tree_bytes;
+	output << ",peak_memory_bytes=" << record.peak_memory_bytes;
+	output << ",evicted_nodes=" << record.evicted_nodes;
+	output << ",timed_out=" << ((record.flags & TELEMETRY_TIMED_OUT) != 0);
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+		if (perf_counted(record, e))
+			output << "," << PerfCounters::event_name(e) << "_per_node="
+					<< per_node(record, perf_count(record, e));
+	}
+	if (record.cycles > 0) {
+		output << ",ipc=" << (double) record.instructions / record.cycles;
+		if (record.flags & TELEMETRY_PERF_SECTIONS) {
+			output << ",emulation_cycle_share="
+					<< (double) record.emulation_cycles / record.cycles;
+			output << ",feature_cycle_share="
+					<< (double) record.feature_cycles / record.cycles;
+		}
+	}
+	output << '\n';
+}
+
+void print_telemetry_tsv_header(std::ostream& output) {
+	output << "episode\tframe\texpanded\tgenerated\tpruned\tjasd_pruned"
+			"\tdepth_tree\ttree_size\tbest_action\tbranch_reward\telapsed"
+			"\tlatency\ttotal_simulation_steps\temulation_time\tcontext_time"
+			"\tfeature_time\tteardown_time\ttree_bytes\tstate_bytes"
+			"\tnode_bytes\tchild_bytes\taction_bytes\tnovelty_bytes"
+			"\tpeak_tree_bytes\tpeak_memory_bytes\tevicted_nodes\ttimed_out";
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+		output << '\t' << PerfCounters::event_name(e) << "_per_node";
+	output << "\tipc\temulation_cycle_share\tfeature_cycle_share" << std::endl;
+}
+
+void print_telemetry_tsv(const TelemetryRecord& record, std::ostream& output) {
+	output << record.episode << '\t' << record.frame << '\t'
+			<< record.expanded << '\t' << record.generated << '\t'
+			<< record.pruned << '\t' << record.jasd_pruned << '\t'
+			<< record.depth << '\t' << record.tree_size << '\t'
+			<< action_to_string((Action) record.action) << '\t'
+			<< record.branch_reward << '\t' << record.elapsed << '\t'
+			<< record.latency_ms << '\t' << record.total_simulation_steps
+			<< '\t' << record.emulation_time << '\t' << record.context_time
+			<< '\t' << record.feature_time << '\t' << record.teardown_time
+			<< '\t' << record.tree_bytes << '\t' << record.state_bytes
+			<< '\t' << record.node_bytes << '\t' << record.child_bytes
+			<< '\t' << record.action_bytes << '\t' << record.novelty_bytes
+			<< '\t' << record.peak_tree_bytes << '\t'
+			<< record.peak_memory_bytes << '\t' << record.evicted_nodes
+			<< '\t' << ((record.flags & TELEMETRY_TIMED_OUT) != 0);
+	// Empty cells for what was not counted
+	for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+		output << '\t';
+		if (perf_counted(record, e))
+			output << per_node(record, perf_count(record, e));
+	}
+	output << '\t';
+	if (record.cycles > 0)
+		output << (double) record.instructions / record.cycles;
+	output << '\t';
+	if (record.cycles > 0 && (record.flags & TELEMETRY_PERF_SECTIONS))
+		output << (double) record.emulation_cycles / record.cycles;
+	output << '\t';
+	if (record.cycles > 0 && (record.flags & TELEMETRY_PERF_SECTIONS))
+		output << (double) record.feature_cycles / record.cycles;
+	output << '\n';
+}
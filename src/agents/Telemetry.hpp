@@ -0,0 +1,144 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Telemetry.hpp
+ *
+ *  Binary per-decision telemetry of the search agent. A telemetry file is a
+ *  TelemetryHeader followed by TelemetryRecords, all in host byte order.
+ *  Records are buffered in chunks and written on a background thread;
+ *  ale-telemetry-dump turns a file back into text.
+ **************************************************************************** */
+
+#ifndef __TELEMETRY_HPP__
+#define __TELEMETRY_HPP__
+
+#include <stdint.h>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Bumped whenever TelemetryRecord changes
+#define TELEMETRY_VERSION 3
+
+struct TelemetryHeader {
+	char magic[8]; // "ALETELEM"
+	uint32_t version;
+	uint32_t record_size;
+};
+
+// One decision of the agent. Ordered by size so that there is no padding.
+struct TelemetryRecord {
+	uint64_t total_simulation_steps;
+	int64_t emulation_time; // microseconds, since the tree was created
+	int64_t context_time;
+	int64_t feature_time;
+	int64_t teardown_time;
+	uint64_t tree_bytes;
+	// Breakdown of tree_bytes, plus the novelty tables (see MemoryUsage)
+	uint64_t state_bytes;
+	uint64_t node_bytes;
+	uint64_t child_bytes;
+	uint64_t action_bytes;
+	uint64_t novelty_bytes;
+	uint64_t peak_tree_bytes; // since the tree was created
+	uint64_t peak_memory_bytes; // novelty tables included
+	double latency_ms; // from begin_decision() to end_decision()
+	double elapsed; // seconds, as in the text trace
+	// Hardware counters of the decision (see -perf_counters), 0 when off
+	uint64_t cycles;
+	uint64_t instructions;
+	uint64_t l1d_misses;
+	uint64_t llc_misses;
+	uint64_t branch_misses;
+	uint64_t emulation_cycles; // with -perf_counters sections
+	uint64_t feature_cycles;
+
+	uint32_t episode;
+	uint32_t frame;
+	uint32_t expanded;
+	uint32_t generated;
+	uint32_t pruned;
+	uint32_t jasd_pruned;
+	uint32_t depth;
+	uint32_t tree_size;
+	int32_t action;
+	float branch_reward;
+	uint32_t evicted_nodes;
+	uint32_t flags; // TELEMETRY_* bits
+};
+
+#define TELEMETRY_TIMED_OUT 1
+#define TELEMETRY_PERF_SECTIONS 2
+// Bit TELEMETRY_PERF_SHIFT + i is set when PerfEvent i was counted
+#define TELEMETRY_PERF_SHIFT 8
+
+class TelemetryWriter {
+public:
+	/** Creates (truncates) path and writes the header. Records are handed
+	 *  to the background thread records_per_chunk at a time. */
+	TelemetryWriter(const std::string& path, size_t records_per_chunk = 256);
+
+	/* *********************************************************************
+	 Destructor: writes everything still buffered and joins the thread.
+	 ******************************************************************* */
+	~TelemetryWriter();
+
+	bool is_open() const {
+		return m_file.is_open();
+	}
+
+	void write(const TelemetryRecord& record);
+
+	/** Hands the records buffered so far to the background thread */
+	void flush();
+
+private:
+	void run();
+
+	std::ofstream m_file;
+	size_t m_records_per_chunk;
+	std::vector<TelemetryRecord> m_chunk;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::vector<std::vector<TelemetryRecord> > m_queue;
+	bool m_stop;
+};
+
+class TelemetryReader {
+public:
+	/** Opens path and checks its header; see ok() */
+	TelemetryReader(const std::string& path);
+
+	bool ok() const {
+		return m_ok;
+	}
+
+	/** Reads the next record; returns false at the end of the file */
+	bool next(TelemetryRecord& record);
+
+private:
+	std::ifstream m_file;
+	bool m_ok;
+};
+
+/** Prints a record with the keys of SearchTree::print_frame_data */
+void print_telemetry_record(const TelemetryRecord& record,
+		std::ostream& output);
+
+/** Prints a record as a tab-separated line, in the order of the header */
+void print_telemetry_tsv_header(std::ostream& output);
+void print_telemetry_tsv(const TelemetryRecord& record, std::ostream& output);
+
+#endif // __TELEMETRY_HPP__
@@ -0,0 +1,109 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Tracing.cpp
+ *
+ *  Per-thread ring buffers of tracing spans and their Chrome trace export.
+ **************************************************************************** */
+
+#include "Tracing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+struct TraceEvent {
+	const char* name;
+	uint64_t start_ns;
+	uint64_t end_ns;
+};
+
+struct TraceBuffer {
+	std::vector<TraceEvent> events;
+	uint64_t recorded; // events[recorded % size] is the next slot
+	unsigned tid;
+};
+
+bool Tracing::s_enabled = false;
+
+static size_t g_buffer_events = 0;
+// Buffers of every thread that recorded a span; they outlive their thread
+// so that its spans can still be exported
+static std::mutex g_buffers_mutex;
+static std::vector<TraceBuffer*> g_buffers;
+static thread_local TraceBuffer* t_buffer = NULL;
+
+void Tracing::enable(size_t buffer_events) {
+	g_buffer_events = (buffer_events > 0 ? buffer_events : 1);
+	s_enabled = true;
+}
+
+uint64_t Tracing::now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracing::record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+	if (t_buffer == NULL) {
+		TraceBuffer* buffer = new TraceBuffer;
+		buffer->events.resize(g_buffer_events);
+		buffer->recorded = 0;
+		std::lock_guard<std::mutex> lock(g_buffers_mutex);
+		buffer->tid = g_buffers.size() + 1;
+		g_buffers.push_back(buffer);
+		t_buffer = buffer;
+	}
+	TraceEvent& event = t_buffer->events[t_buffer->recorded
+			% t_buffer->events.size()];
+	event.name = name;
+	event.start_ns = start_ns;
+	event.end_ns = end_ns;
+	t_buffer->recorded++;
+}
+
+bool Tracing::write_chrome_trace(const std::string& path) {
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == NULL)
+		return false;
+
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+	// Timestamps are relative to the first span kept
+	uint64_t origin = UINT64_MAX;
+	for (size_t b = 0; b < g_buffers.size(); ++b) {
+		TraceBuffer* buffer = g_buffers[b];
+		uint64_t size = buffer->events.size();
+		uint64_t first = (buffer->recorded > size ? buffer->recorded - size : 0);
+		for (uint64_t i = first; i < buffer->recorded; ++i) {
+			origin = std::min(origin, buffer->events[i % size].start_ns);
+		}
+	}
+
+	int pid = getpid();
+	bool comma = false;
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (size_t b = 0; b < g_buffers.size(); ++b) {
+		TraceBuffer* buffer = g_buffers[b];
+		uint64_t size = buffer->events.size();
+		uint64_t first = (buffer->recorded > size ? buffer->recorded - size : 0);
+		for (uint64_t i = first; i < buffer->recorded; ++i) {
+			const TraceEvent& event = buffer->events[i % size];
+			fprintf(file,
+					"%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+							"\"pid\":%d,\"tid\":%u}\n", comma ? "," : "",
+					event.name, (event.start_ns - origin) / 1000.0,
+					(event.end_ns - event.start_ns) / 1000.0, pid, buffer->tid);
+			comma = true;
+		}
+	}
+	fprintf(file, "],\"displayTimeUnit\":\"ns\"}\n");
+	return fclose(file) == 0;
+}
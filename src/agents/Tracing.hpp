@@ -0,0 +1,80 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  Tracing.hpp
+ *
+ *  Scoped tracing spans of the search, exported as a Chrome trace that
+ *  chrome://tracing and Perfetto open. TRACE_SPAN("name") times the rest of
+ *  the enclosing scope. Spans only exist in builds with USE_TRACING := 1
+ *  (-D__USE_TRACING); otherwise TRACE_SPAN expands to nothing.
+ *
+ *  Every thread records into its own ring buffer, so the last spans of each
+ *  thread are kept and no lock is taken on the hot path.
+ **************************************************************************** */
+
+#ifndef __TRACING_HPP__
+#define __TRACING_HPP__
+
+#include <stdint.h>
+#include <string>
+
+class Tracing {
+public:
+	/** Starts recording, keeping the last buffer_events spans of every
+	 *  thread. Call it before the threads of the search start. */
+	static void enable(size_t buffer_events);
+
+	static bool enabled() {
+		return s_enabled;
+	}
+
+	/** Writes the spans kept so far as Chrome trace JSON. Call it while no
+	 *  search is running. Returns false if path cannot be written. */
+	static bool write_chrome_trace(const std::string& path);
+
+	/** Nanoseconds on a monotonic clock */
+	static uint64_t now_ns();
+
+	/** Records a span of the calling thread; name must be a literal */
+	static void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+private:
+	static bool s_enabled;
+};
+
+#ifdef __USE_TRACING
+
+class TraceSpan {
+public:
+	TraceSpan(const char* name) :
+			m_name(name), m_recording(Tracing::enabled()), m_start(
+					m_recording ? Tracing::now_ns() : 0) {
+	}
+	~TraceSpan() {
+		if (m_recording)
+			Tracing::record(m_name, m_start, Tracing::now_ns());
+	}
+
+private:
+	const char* m_name;
+	bool m_recording;
+	uint64_t m_start;
+};
+
+#define TRACE_SPAN_NAME2(line) trace_span_##line
+#define TRACE_SPAN_NAME(line) TRACE_SPAN_NAME2(line)
+#define TRACE_SPAN(name) TraceSpan TRACE_SPAN_NAME(__LINE__)(name)
+
+#else
+
+#define TRACE_SPAN(name)
+
+#endif // __USE_TRACING
+
+#endif // __TRACING_HPP__
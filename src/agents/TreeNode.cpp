@@ -50,17 +50,19 @@ TreeNode::TreeNode(TreeNode* parent, ALEState &parentState, SearchTree * tree,
 
 	if (tree) {
 		init(tree, a, num_simulate_steps);
-		discounted_node_reward = node_reward * discount;
-		if (parent == NULL) {
-			accumulated_reward = node_reward;
-			discounted_accumulated_reward = discounted_node_reward;
-		} else {
-			accumulated_reward = parent->accumulated_reward + node_reward;
-			discounted_accumulated_reward =
-					parent->discounted_accumulated_reward
-							+ discounted_node_reward;
-		}
+		accumulate_reward();
+	}
+}
 
+void TreeNode::accumulate_reward() {
+	discounted_node_reward = node_reward * discount;
+	if (p_parent == NULL) {
+		accumulated_reward = node_reward;
+		discounted_accumulated_reward = discounted_node_reward;
+	} else {
+		accumulated_reward = p_parent->accumulated_reward + node_reward;
+		discounted_accumulated_reward = p_parent->discounted_accumulated_reward
+				+ discounted_node_reward;
 	}
 }
 
@@ -89,8 +91,13 @@ void TreeNode::init(SearchTree * tree, Action a, int num_simulate_steps) {
 	return_t step_return;
 //	num_simulated_steps = tree->simulate_game(state, a, num_simulate_steps,
 //			step_return, is_terminal, false);
-	num_simulated_steps = tree->simulate_game_err(state, a, num_simulate_steps,
+	int steps = tree->simulate_game_err(state, a, num_simulate_steps,
 			step_return, is_terminal, false);
+	init(steps, step_return);
+}
+
+void TreeNode::init(int simulated_steps, return_t step_return) {
+	num_simulated_steps = simulated_steps;
 	node_reward = (reward_t) step_return;
 
 	// Initialize the branch reward to the received node reward
@@ -46,6 +46,13 @@ public:
 	/** Properly generate this node by simulating it from the start state */
 	void init(SearchTree * tree, Action a, int num_simulate_steps);
 
+	/** Initializes this node from a simulation that was run elsewhere, e.g.
+	 *  on a worker emulator; state and is_terminal already hold its result */
+	void init(int simulated_steps, return_t step_return);
+
+	/** Accumulates the rewards along the path from the parent */
+	void accumulate_reward();
+
 	/**
 	 * Updates Tree Node info if it's reused from previous lookahead
 	 */
@@ -0,0 +1,103 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  TreeReclaimer.cpp
+ *
+ *  Frees discarded subtrees of the search tree on a background thread so that
+ *  the teardown does not sit on the critical path between two decisions.
+ **************************************************************************** */
+
+#include "TreeReclaimer.hpp"
+#include "TreeNode.hpp"
+#include "Tracing.hpp"
+
+#include <chrono>
+
+TreeReclaimer::TreeReclaimer() :
+		m_busy(false), m_stop(false), m_reclaimed_time(0), m_reclaimed_nodes(
+				0) {
+	m_thread = std::thread(&TreeReclaimer::run, this);
+}
+
+TreeReclaimer::~TreeReclaimer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeup.notify_one();
+	m_thread.join();
+}
+
+void TreeReclaimer::reclaim(TreeNode* node) {
+	if (node == nullptr) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(node);
+	}
+	m_wakeup.notify_one();
+}
+
+void TreeReclaimer::wait() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_drained.wait(lock, [this] {return m_queue.empty() && !m_busy;});
+}
+
+void TreeReclaimer::run() {
+	std::vector<TreeNode*> batch;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_busy = false;
+			if (m_queue.empty()) {
+				m_drained.notify_all();
+			}
+			m_wakeup.wait(lock, [this] {return m_stop || !m_queue.empty();});
+			if (m_queue.empty() && m_stop) {
+				return;
+			}
+			batch.swap(m_queue);
+			m_busy = true;
+		}
+
+		TRACE_SPAN("teardown");
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned nodes = 0;
+		for (size_t i = 0; i < batch.size(); ++i) {
+			nodes += delete_subtree(batch[i]);
+		}
+		batch.clear();
+		auto elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		m_reclaimed_time += std::chrono::duration_cast<
+				std::chrono::microseconds>(elapsed).count();
+		m_reclaimed_nodes += nodes;
+	}
+}
+
+// Same traversal as SearchTree::delete_branch, but with an explicit stack so
+// that a very deep discarded branch cannot overflow the thread's stack.
+unsigned TreeReclaimer::delete_subtree(TreeNode* node) {
+	unsigned nodes = 0;
+	std::vector<TreeNode*> stack;
+	stack.push_back(node);
+	while (!stack.empty()) {
+		TreeNode* curr = stack.back();
+		stack.pop_back();
+		for (size_t c = 0; c < curr->v_children.size(); c++) {
+			if (curr->v_children[c] != nullptr) {
+				stack.push_back(curr->v_children[c]);
+			}
+		}
+		delete curr;
+		++nodes;
+	}
+	return nodes;
+}
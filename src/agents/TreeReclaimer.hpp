@@ -0,0 +1,69 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  TreeReclaimer.hpp
+ *
+ *  Frees discarded subtrees of the search tree on a background thread so that
+ *  the teardown does not sit on the critical path between two decisions.
+ **************************************************************************** */
+
+#ifndef __TREE_RECLAIMER_HPP__
+#define __TREE_RECLAIMER_HPP__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class TreeNode;
+
+class TreeReclaimer {
+public:
+	TreeReclaimer();
+
+	/* *********************************************************************
+	 Destructor: frees everything still queued and joins the thread.
+	 ******************************************************************* */
+	~TreeReclaimer();
+
+	/** Hands over a detached subtree. The caller must not touch the node
+	 *  (or any of its descendants) afterwards. */
+	void reclaim(TreeNode* node);
+
+	/** Blocks until every subtree handed over so far has been freed. */
+	void wait();
+
+	/** Microseconds spent freeing subtrees on the background thread */
+	long long reclaimed_time() const {
+		return m_reclaimed_time;
+	}
+	/** Number of nodes freed on the background thread */
+	unsigned long long reclaimed_nodes() const {
+		return m_reclaimed_nodes;
+	}
+
+private:
+	void run();
+
+	unsigned delete_subtree(TreeNode* node);
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::condition_variable m_drained;
+	std::vector<TreeNode*> m_queue;
+	bool m_busy;
+	bool m_stop;
+
+	std::atomic<long long> m_reclaimed_time;
+	std::atomic<unsigned long long> m_reclaimed_nodes;
+};
+
+#endif // __TREE_RECLAIMER_HPP__
@@ -15,16 +15,23 @@
 
 #include "DominatedActionSequenceDetection.hpp"
 #include "UCTTreeNode.hpp"
+#include "EmulatorPool.hpp"
+
+#include <chrono>
+#include <thread>
 
 #include "random_tools.h"
 #include "misc_tools.h"
 
 UCTSearchTree::UCTSearchTree(RomSettings * rom_settings, Settings &settings,
 		ActionVect &actions, StellaEnvironment* _env) :
-		SearchTree(rom_settings, settings, actions, _env) {
+		SearchTree(rom_settings, settings, actions, _env), m_settings(settings), m_own_context(
+				NULL), m_parallel_steps(0), m_in_flight(0), m_parallel_stop(
+				false), m_parallel_search_time(0) {
 
 	// default = -1 : unlimited
 	uct_max_simulations = settings.getInt("uct_monte_carlo_steps", true);
+	m_simulation_budget = uct_max_simulations;
 	// default = 300: should be rescaled to the number of frames available to the agent?
 	uct_search_depth = settings.getInt("uct_search_depth", true);
 	// default = 0.1: the UCT bias. Don't wanna dig deep into this...
@@ -60,12 +67,60 @@ UCTSearchTree::UCTSearchTree(RomSettings * rom_settings, Settings &settings,
 	if (m_max_action) {
 		printf("uct_max_action\n");
 	}
+
+	// Default: serial UCT
+	// "root" or "tree" parallel UCT on the workers of num_emulator_threads.
+	std::string parallel = settings.getString("uct_parallel", false);
+	m_parallel_mode = UCT_SERIAL;
+	if (parallel == "root") {
+		m_parallel_mode = UCT_ROOT_PARALLEL;
+	} else if (parallel == "tree") {
+		m_parallel_mode = UCT_TREE_PARALLEL;
+	} else if (!parallel.empty()) {
+		printf("uct_parallel: unknown mode %s, running serial\n",
+				parallel.c_str());
+	}
+
+	// Default: 1
+	// Visits added along a path selected by a tree-parallel worker.
+	m_virtual_loss = settings.getInt("uct_virtual_loss", false);
+	if (m_virtual_loss <= 0) {
+		m_virtual_loss = 1;
+	}
+	if (m_parallel_mode != UCT_SERIAL) {
+		printf("uct_parallel: %s", parallel.c_str());
+		if (m_parallel_mode == UCT_TREE_PARALLEL) {
+			printf(", virtual loss %d", m_virtual_loss);
+		}
+		printf("\n");
+	}
+}
+
+UCTSearchTree::UCTSearchTree(const UCTSearchTree& parent,
+		StellaEnvironment* _env) :
+		SearchTree(parent, _env), uct_biased_rollout(
+				parent.uct_biased_rollout), biased_action(
+				parent.biased_action), m_max_action(parent.m_max_action), uct_max_simulations(
+				parent.uct_max_simulations), m_simulation_budget(
+				parent.m_simulation_budget), uct_search_depth(
+				parent.uct_search_depth), uct_exploration_constant(
+				parent.uct_exploration_constant), uct_num_monte_carlo(
+				parent.uct_num_monte_carlo), m_settings(parent.m_settings), m_parallel_mode(
+				UCT_SERIAL), m_virtual_loss(parent.m_virtual_loss), m_own_context(
+				NULL), m_parallel_steps(0), m_in_flight(0), m_parallel_stop(
+				false), m_parallel_search_time(0) {
 }
 
 /* *********************************************************************
  Destructor
  ******************************************************************* */
 UCTSearchTree::~UCTSearchTree() {
+	for (size_t i = 0; i < m_root_trees.size(); ++i) {
+		delete m_root_trees[i];
+	}
+	for (size_t i = 0; i < m_contexts.size(); ++i) {
+		delete m_contexts[i];
+	}
 }
 
 /* *********************************************************************
@@ -86,13 +141,23 @@ void UCTSearchTree::build(ALEState & state) {
  or until we have the required number of UCT simulations.
  ******************************************************************* */
 void UCTSearchTree::update_tree(void) {
+	if (m_emulator_pool != NULL && m_parallel_mode == UCT_ROOT_PARALLEL) {
+		update_tree_root_parallel();
+	} else if (m_emulator_pool != NULL
+			&& m_parallel_mode == UCT_TREE_PARALLEL) {
+		update_tree_tree_parallel();
+	} else {
+		update_tree_serial();
+	}
+}
+
+void UCTSearchTree::update_tree_serial() {
 	m_generated_nodes = 0;
 	m_expanded_nodes = 0;
 	m_max_depth = 0;
 	int simulation_steps = ((UCTTreeNode*) p_root)->num_steps();
 
-	std::cout << "starting with " << simulation_steps << " simulation steps"
-			<< std::endl;
+	LOG(LOG_DEBUG, "starting with %d simulation steps\n", simulation_steps);
 
 	int num_iterations = 0;
 	while (true) {
@@ -104,7 +169,7 @@ void UCTSearchTree::update_tree(void) {
 		//  of frames
 		if (max_sim_steps_per_frame != -1
 				&& simulation_steps >= max_sim_steps_per_frame) {
-			printf(
+			LOG(LOG_DEBUG,
 					"break by max_sim_steps_per_frame: %d simulation_steps >= %d\n",
 					simulation_steps, max_sim_steps_per_frame);
 			break;
@@ -115,26 +180,228 @@ void UCTSearchTree::update_tree(void) {
 		else if (uct_max_simulations != -1
 				&& ((UCTTreeNode*) p_root)->visit_count
 						>= uct_max_simulations) {
-			printf("break by uct_max_simulations: %d >= %d \n",
+			LOG(LOG_DEBUG, "break by uct_max_simulations: %d >= %d \n",
 					((UCTTreeNode*) p_root)->visit_count, uct_max_simulations);
 			break;
 		}
+		else if (out_of_time()) {
+			LOG(LOG_DEBUG, "break by max_planning_ms: %d ms\n",
+					m_max_planning_ms);
+			break;
+		}
 		// Handle the case where we cannot simulate further but have not reached the
 		//  maximum number of simulation steps per frame (thanks to Erik Talvitie
 		//  for this one)
 		else if (num_simulations_per_frame == -1 && new_sim_steps == 0) {
-			printf("new_sim_steps == 0\n");
+			LOG(LOG_DEBUG, "new_sim_steps == 0\n");
 			break;
 		}
 	}
-	std::cout << "Simulation steps: " << simulation_steps << std::endl;
-	std::cout << "Visits to root: " << ((UCTTreeNode*) p_root)->visit_count
-			<< std::endl;
+	LOG(LOG_DEBUG, "Simulation steps: %d\n", simulation_steps);
+	LOG(LOG_DEBUG, "Visits to root: %d\n", ((UCTTreeNode*) p_root)->visit_count);
 	total_simulation_steps += simulation_steps;
 
 //	print_tree();
 }
 
+void UCTSearchTree::apply_budget_scale() {
+	SearchTree::apply_budget_scale();
+	if (m_simulation_budget != -1) {
+		uct_max_simulations = std::max(1,
+				(int) (m_simulation_budget * m_budget_scale));
+	}
+}
+
+// Share i of a budget split over n workers (-1 stays unlimited)
+static int budget_share(int budget, int i, int n) {
+	if (budget == -1)
+		return -1;
+	return budget / n + (i < budget % n ? 1 : 0);
+}
+
+void UCTSearchTree::update_tree_root_parallel() {
+	UCTTreeNode* root = (UCTTreeNode*) p_root;
+	m_generated_nodes = 0;
+	m_expanded_nodes = 0;
+	m_max_depth = 0;
+	create_contexts();
+
+	int num_workers = m_emulator_pool->size();
+	if (m_root_trees.empty()) {
+		for (int i = 0; i < num_workers; ++i) {
+			UCTSearchTree* tree = new UCTSearchTree(*this,
+					m_emulator_pool->environment(i));
+			tree->m_own_context = m_contexts[i];
+			m_root_trees.push_back(tree);
+		}
+	}
+
+	// Steps and simulations already spent on the reused tree count
+	//  against the budget, as in the serial search
+	int steps_left = -1;
+	if (max_sim_steps_per_frame != -1) {
+		steps_left = std::max(0, max_sim_steps_per_frame - root->num_steps());
+	}
+	int simulations_left = -1;
+	if (uct_max_simulations != -1) {
+		simulations_left = std::max(0,
+				uct_max_simulations - root->visit_count);
+	}
+	for (int i = 0; i < num_workers; ++i) {
+		UCTSearchTree* tree = m_root_trees[i];
+		tree->max_sim_steps_per_frame = budget_share(steps_left, i,
+				num_workers);
+		tree->uct_max_simulations = budget_share(simulations_left, i,
+				num_workers);
+		tree->m_max_planning_ms = m_max_planning_ms;
+		tree->m_planning_deadline = m_planning_deadline;
+		tree->set_player_B(m_player_B);
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_emulator_pool->run_on_each([this, root](size_t id, StellaEnvironment*) {
+		UCTSearchTree* tree = m_root_trees[id];
+		tree->clear();
+		if (tree->max_sim_steps_per_frame == 0
+				|| tree->uct_max_simulations == 0) {
+			return;
+		}
+		tree->m_emulation_time = 0;
+		tree->m_context_time = 0;
+		tree->m_total_simulation_steps = 0;
+		tree->build(root->state);
+	});
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_parallel_search_time = std::chrono::duration_cast<
+			std::chrono::microseconds>(elapsed).count();
+
+	for (int i = 0; i < num_workers; ++i) {
+		UCTSearchTree* tree = m_root_trees[i];
+		if (tree->p_root == NULL) {
+			continue;
+		}
+		m_expanded_nodes += tree->m_expanded_nodes;
+		m_generated_nodes += tree->m_generated_nodes;
+		m_max_depth = std::max(m_max_depth, tree->m_max_depth);
+		m_emulation_time += tree->m_emulation_time;
+		m_context_time += tree->m_context_time;
+		m_total_simulation_steps += tree->m_total_simulation_steps;
+		total_simulation_steps += tree->num_simulation_steps();
+		if (tree->m_timed_out)
+			m_timed_out = true;
+	}
+	merge_contexts();
+
+	// Merge the worker trees at the root. A new root gets placeholder
+	//  children, not simulated; each one is taken over, with its subtree,
+	//  from the first worker that simulated it, and the visits of the other
+	//  workers are added to it. Children of a reused root only get the
+	//  visits.
+	if (root->is_leaf()) {
+		m_expanded_nodes++;
+		for (size_t i = 0; i < available_actions.size(); i++) {
+			root->v_children.push_back(
+					new UCTTreeNode(root, root->state, sim_steps_per_node,
+							available_actions[i], NULL));
+		}
+	}
+	for (int i = 0; i < num_workers; ++i) {
+		UCTTreeNode* worker_root = (UCTTreeNode*) m_root_trees[i]->p_root;
+		if (worker_root == NULL || worker_root->is_leaf()) {
+			continue;
+		}
+		root->visit_count += worker_root->visit_count;
+		for (size_t c = 0; c < root->v_children.size(); c++) {
+			UCTTreeNode* child = (UCTTreeNode*) root->v_children[c];
+			UCTTreeNode* worker_child =
+					(UCTTreeNode*) worker_root->v_children[c];
+			if (!worker_child->is_initialized()) {
+				continue;
+			}
+			if (!child->is_initialized()) {
+				root->v_children[c] = worker_child;
+				worker_child->p_parent = root;
+				worker_root->v_children[c] = child;
+				child->p_parent = worker_root;
+			} else {
+				child->visit_count += worker_child->visit_count;
+				child->sum_returns += worker_child->sum_returns;
+			}
+		}
+	}
+
+	// No worker got to search (the reused tree had spent the budget)
+	for (size_t c = 0; c < root->v_children.size(); c++) {
+		UCTTreeNode* child = (UCTTreeNode*) root->v_children[c];
+		if (!child->is_initialized()) {
+			child->init(this, child->act, sim_steps_per_node);
+			child->accumulate_reward();
+		}
+	}
+
+	LOG(LOG_DEBUG, "Root parallel: %d trees\n", num_workers);
+	LOG(LOG_DEBUG, "Visits to root: %d\n", root->visit_count);
+}
+
+void UCTSearchTree::update_tree_tree_parallel() {
+	UCTTreeNode* root = (UCTTreeNode*) p_root;
+	m_generated_nodes = 0;
+	m_expanded_nodes = 0;
+	m_max_depth = 0;
+	create_contexts();
+
+	m_parallel_steps = root->num_steps();
+	m_in_flight = 0;
+	m_parallel_stop = false;
+
+	LOG(LOG_DEBUG, "starting with %d simulation steps\n", m_parallel_steps);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_emulator_pool->run_on_each([this](size_t id, StellaEnvironment* env) {
+		RolloutContext* ctx = m_contexts[id];
+		ctx->env = env;
+		while (uct_iteration(ctx) >= 0) {
+		}
+	});
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_parallel_search_time = std::chrono::duration_cast<
+			std::chrono::microseconds>(elapsed).count();
+
+	merge_contexts();
+
+	LOG(LOG_DEBUG, "Simulation steps: %d\n", m_parallel_steps);
+	LOG(LOG_DEBUG, "Visits to root: %d\n", root->visit_count);
+	total_simulation_steps += m_parallel_steps;
+}
+
+void UCTSearchTree::create_contexts() {
+	if (!m_contexts.empty()) {
+		return;
+	}
+	for (int i = 0; i < m_emulator_pool->size(); ++i) {
+		RolloutContext* ctx = new RolloutContext();
+		ctx->env = m_emulator_pool->environment(i);
+		// Seeded from rand() so that random_seed still fixes the search
+		ctx->rng.seed(rand());
+		ctx->simulation_steps = 0;
+		ctx->context_time = 0;
+		ctx->emulation_time = 0;
+		m_contexts.push_back(ctx);
+	}
+}
+
+void UCTSearchTree::merge_contexts() {
+	for (size_t i = 0; i < m_contexts.size(); ++i) {
+		RolloutContext* ctx = m_contexts[i];
+		m_total_simulation_steps += ctx->simulation_steps;
+		m_context_time += ctx->context_time;
+		m_emulation_time += ctx->emulation_time;
+		ctx->simulation_steps = 0;
+		ctx->context_time = 0;
+		ctx->emulation_time = 0;
+	}
+}
+
 void UCTSearchTree::print_path(TreeNode * node, int a) {
 	cerr << "Path, return " << node->v_children[a]->branch_return << endl;
 
@@ -176,17 +443,19 @@ Action UCTSearchTree::get_best_action(void) {
 	// Replace the best branch by our actual choice 
 	p_root->best_branch = best_branch;
 
-	for (size_t c = 0; c < p_root->v_children.size(); c++) {
-		TreeNode* curr_child = p_root->v_children[c];
-
-		std::cout << "Action: " << action_to_string(available_actions[c])
-				<< " Depth: " << curr_child->branch_depth << " NumNodes: "
-				<< curr_child->num_nodes() << " Reward: "
-				<< curr_child->branch_return << std::endl;
+	// num_nodes() walks the whole subtree: only when the line is printed
+	if (Logger::enabled(LOG_DEBUG)) {
+		for (size_t c = 0; c < p_root->v_children.size(); c++) {
+			TreeNode* curr_child = p_root->v_children[c];
 
+			LOG(LOG_DEBUG, "Action: %s Depth: %g NumNodes: %d Reward: %g\n",
+					action_to_string(available_actions[c]).c_str(),
+					(double) curr_child->branch_depth, curr_child->num_nodes(),
+					(double) curr_child->branch_return);
+		}
 	}
 
-	std::cout << "Action " << best_branch << std::endl;
+	LOG(LOG_DEBUG, "Action %d\n", best_branch);
 	return available_actions[best_branch];
 }
 
@@ -194,6 +463,33 @@ Action UCTSearchTree::get_best_action(void) {
  Performs a single UCT iteration, starting from the root
  ******************************************************************* */
 int UCTSearchTree::single_uct_iteration(void) {
+	return uct_iteration(m_own_context);
+}
+
+int UCTSearchTree::uct_iteration(RolloutContext* ctx) {
+	std::unique_lock<std::mutex> lock(m_tree_mutex, std::defer_lock);
+	bool tree_parallel = (ctx != NULL && m_parallel_mode == UCT_TREE_PARALLEL);
+	if (tree_parallel) {
+		lock.lock();
+		if (m_parallel_stop) {
+			return -1;
+		}
+		if (max_sim_steps_per_frame != -1
+				&& m_parallel_steps >= max_sim_steps_per_frame) {
+			return -1;
+		}
+		// Iterations in flight will each add one real visit to the root
+		int root_visits = ((UCTTreeNode*) p_root)->visit_count
+				- m_in_flight * (m_virtual_loss - 1);
+		if (uct_max_simulations != -1 && root_visits >= uct_max_simulations) {
+			return -1;
+		}
+		// The root keeps its children, so there is always a best action
+		if (!p_root->is_leaf() && out_of_time()) {
+			return -1;
+		}
+	}
+
 	// Traverse the tree down to a leaf node; traversal happens using UCT
 	//  exploration
 	TreeNode * node;
@@ -218,7 +514,7 @@ int UCTSearchTree::single_uct_iteration(void) {
 
 			assert(!all_dups);
 
-			int unvisited_child = get_child_with_count_zero(node);
+			int unvisited_child = get_child_with_count_zero(node, ctx);
 			if (unvisited_child != -1) {
 				zero_count_leaf = true;
 				node = node->v_children[unvisited_child];
@@ -230,7 +526,7 @@ int UCTSearchTree::single_uct_iteration(void) {
 				break;
 			} else {
 				// Select an action via UCT exploration
-				int uct_choice = get_best_branch((UCTTreeNode*) node, true);
+				int uct_choice = get_best_branch((UCTTreeNode*) node, true, ctx);
 				node = node->v_children[uct_choice];
 			}
 		}
@@ -238,9 +534,17 @@ int UCTSearchTree::single_uct_iteration(void) {
 // If this is not an unvisited child, then we should expand the node
 //  so that it isn't a leaf anymore
 		if (!zero_count_leaf) {
-			expand_node(node);
+			if (!tree_parallel) {
+				expand_node(node);
+			} else if (!expand_unlocked((UCTTreeNode*) node, false,
+					PLAYER_A_NOOP, ctx, lock)) {
+				// Let the worker expanding it finish
+				lock.unlock();
+				std::this_thread::yield();
+				return 0;
+			}
 
-			vector<Action> usefulActions = getEffectiveActionsVector(node);
+			vector<Action> usefulActions = getEffectiveActionsVector(node, ctx);
 
 //			printf("usefulActions = ");
 //			for (unsigned int a = 0; a < usefulActions.size(); ++a) {
@@ -254,7 +558,7 @@ int UCTSearchTree::single_uct_iteration(void) {
 				usefulActions = available_actions;
 			}
 //			int c = choice(&usefulActions);
-			int c = rand() % available_actions.size(); // TODO:
+			int c = random_index(available_actions.size(), ctx); // TODO:
 			node = node->v_children[c];
 
 			leaf_choice = available_actions[c];
@@ -270,8 +574,15 @@ int UCTSearchTree::single_uct_iteration(void) {
 			m_max_depth = node->depth();
 
 		if (!node->initialized) {
-			printf("uninitialized\n");
-			node->init(this, leaf_choice, sim_steps_per_node);
+			LOG(LOG_TRACE, "uninitialized\n");
+			if (!tree_parallel) {
+				node->init(this, leaf_choice, sim_steps_per_node);
+			} else if (!expand_unlocked((UCTTreeNode*) node, true,
+					leaf_choice, ctx, lock)) {
+				lock.unlock();
+				std::this_thread::yield();
+				return 0;
+			}
 		}
 
 // Before declaring ourselves done, ensure that this is not a duplicate
@@ -300,18 +611,46 @@ int UCTSearchTree::single_uct_iteration(void) {
 	// TODO: Why doesn't it go further than the maximal depth?
 	int mc_steps = uct_search_depth - node_depth;
 
+	// Other workers see the path as already visited, and a poorer one,
+	//  while its rollouts run without the lock
+	if (tree_parallel) {
+		add_virtual_loss((UCTTreeNode*) node, m_virtual_loss);
+		++m_in_flight;
+		lock.unlock();
+	}
+
 	float average_return = 0.0;
 	if (uct_num_monte_carlo == 0) {
 		average_return = node->accumulated_reward;
+	} else if (ctx == NULL && m_emulator_pool != NULL
+			&& uct_num_monte_carlo > 1) {
+		return_t leaf_return;
+		sim_steps += leaf_parallel_monte_carlo((UCTTreeNode*) node, mc_steps,
+				leaf_return);
+		average_return = leaf_return;
 	} else {
 		for (int i = 0; i < uct_num_monte_carlo; ++i) {
 			sim_steps += do_monte_carlo((UCTTreeNode*) node, mc_steps,
-					mc_return);
+					mc_return, ctx);
 			average_return += mc_return;
 		}
 		average_return /= (float) uct_num_monte_carlo;
 	}
 
+	if (tree_parallel) {
+		lock.lock();
+		add_virtual_loss((UCTTreeNode*) node, -m_virtual_loss);
+		--m_in_flight;
+		m_parallel_steps += sim_steps;
+		// Same as the serial search: stop when nothing can be simulated
+		if (num_simulations_per_frame == -1 && sim_steps == 0) {
+			m_parallel_stop = true;
+		}
+	}
+
+	m_generated_nodes += uct_num_monte_carlo;
+	((UCTTreeNode*) node)->sim_steps += sim_steps;
+
 	// Propagate the return back up
 	update_values((UCTTreeNode*) node, average_return);
 
@@ -322,12 +661,13 @@ int UCTSearchTree::single_uct_iteration(void) {
  Returns the index of the first child with zero count
  Returns -1 if no such child is found
  ******************************************************************* */
-int UCTSearchTree::get_child_with_count_zero(const TreeNode* node) const {
+int UCTSearchTree::get_child_with_count_zero(const TreeNode* node,
+		RolloutContext* ctx) const {
 	// This method gets call infrequently enough that there is little gain in
 	//  making unvisited_children a class member variable
 	IntVect unvisited_children;
 
-	vector<Action> usefulActions = getEffectiveActionsVector(node);
+	vector<Action> usefulActions = getEffectiveActionsVector(node, ctx);
 
 	for (size_t c = 0; c < usefulActions.size(); c++) {
 //		int act = (int) usefulActions[c];
@@ -340,20 +680,22 @@ int UCTSearchTree::get_child_with_count_zero(const TreeNode* node) const {
 	if (unvisited_children.empty())
 		return -1;
 	else
-		return choice(&unvisited_children);
+		return unvisited_children[random_index(unvisited_children.size(),
+				ctx)];
 }
 
 /* *********************************************************************
  Returns the sub-branch with the highest value if add_uct_bias is true
  we will add the UCT bonus to each branch value and then take the max
  ******************************************************************* */
-int UCTSearchTree::get_best_branch(UCTTreeNode* node, bool add_uct_bias) {
+int UCTSearchTree::get_best_branch(UCTTreeNode* node, bool add_uct_bias,
+		RolloutContext* ctx) {
 	int best_branch = -1;
 	float highest_value = 0;
 
 	assert(!node->v_children.empty());
 
-	vector<Action> usefulAction = getEffectiveActionsVector(node);
+	vector<Action> usefulAction = getEffectiveActionsVector(node, ctx);
 
 	// We want to tie-break actions with the same value
 	vector<int> ties;
@@ -402,12 +744,12 @@ int UCTSearchTree::get_best_branch(UCTTreeNode* node, bool add_uct_bias) {
 
 	// If we have ties, pick one at random
 	if (ties.size() > 1) {
-		best_branch = choice(&ties);
+		best_branch = ties[random_index(ties.size(), ctx)];
 //		assert(best_branch != -1 && "ties has -1 branch");
 	}
 
 	if (best_branch == -1) {
-		best_branch = rand() % node->v_children.size();
+		best_branch = random_index(node->v_children.size(), ctx);
 	}
 	assert(best_branch != -1);
 
@@ -480,11 +822,9 @@ void UCTSearchTree::expand_node(TreeNode* node) {
  'num_steps' steps
  ******************************************************************* */
 int UCTSearchTree::do_monte_carlo(UCTTreeNode* start_node, int num_steps,
-		return_t& mc_return) {
-
-	m_generated_nodes++;
-
-	m_env->restoreState(start_node->state);
+		return_t& mc_return, RolloutContext* ctx) {
+	// Every rollout segment restores start_node->state itself, and skips
+	//  that when m_env already holds it (e.g. the leaf was just simulated)
 	bool is_terminal;
 
 	// TODO: YJ: Rollout is run here. RANDOM should take into account of DASP/DASA.
@@ -508,7 +848,8 @@ int UCTSearchTree::do_monte_carlo(UCTTreeNode* start_node, int num_steps,
 			// TODO: enable action_sequence_detection for restricted action.
 			vector<bool> isUsefulAction = dasd->getEffectiveActions(
 					previousActions,
-					this->trajectory.size() * sim_steps_per_node);
+					this->trajectory.size() * sim_steps_per_node,
+					ctx != NULL ? &ctx->rng : NULL);
 			for (unsigned int a = 0; a < isUsefulAction.size(); ++a) {
 				if (isUsefulAction[a]) {
 					usefulActions.push_back((Action) a);
@@ -535,9 +876,9 @@ int UCTSearchTree::do_monte_carlo(UCTTreeNode* start_node, int num_steps,
 		if (usefulActions.size() == 0) {
 			usefulActions = available_actions;
 		}
-		Action action = choice(&usefulActions);
-		steps += simulate_game_err(start_node->state, (Action) action,
-				sim_steps_per_node, mc_return, is_terminal, true, false);
+		Action action = usefulActions[random_index(usefulActions.size(), ctx)];
+		steps += simulate_rollout(ctx, start_node->state, action,
+				sim_steps_per_node, mc_return, is_terminal);
 		if (action_sequence_detection) {
 			if (!previousActions.empty()) {
 				previousActions.erase(previousActions.begin());
@@ -546,15 +887,144 @@ int UCTSearchTree::do_monte_carlo(UCTTreeNode* start_node, int num_steps,
 		}
 	}
 
-	start_node->sim_steps += steps;
-	// Reset its frame number for consistency
-	m_env->restoreState(start_node->state);
 
 	// Note - we do not care here if we reach a terminal node (indicated
 	//  by is_terminal being set to true)
 	return steps;
 }
 
+int UCTSearchTree::simulate_rollout(RolloutContext* ctx, ALEState& state,
+		Action act, int num_steps, return_t &traj_return, bool &game_ended,
+		bool discount_return, bool save_state) {
+	if (ctx == NULL) {
+		return simulate_game_err(state, act, num_steps, traj_return,
+				game_ended, discount_return, save_state);
+	}
+
+	if (erroneous_prediction) {
+		pair<Action, int> rnd = randomizeAction(act, num_steps, &ctx->rng);
+		act = rnd.first;
+		num_steps = rnd.second;
+	}
+	reward_t first_reward;
+	int steps = simulate_on(ctx->env, state, act, num_steps, traj_return,
+			first_reward, game_ended, discount_return, save_state,
+			ctx->context_time, ctx->emulation_time);
+	ctx->simulation_steps += steps;
+
+	if (normalize_rewards) {
+		// reward_magnitude is shared with the other rollouts in flight
+		std::lock_guard<std::mutex> lock(m_tree_mutex);
+		traj_return = normalize_return(traj_return, first_reward);
+	}
+	return steps;
+}
+
+bool UCTSearchTree::expand_unlocked(UCTTreeNode* node, bool init_leaf,
+		Action leaf_choice, RolloutContext* ctx,
+		std::unique_lock<std::mutex>& lock) {
+	if (node->in_expansion) {
+		return false;
+	}
+	node->in_expansion = true;
+	add_virtual_loss(node, m_virtual_loss);
+	++m_in_flight;
+	lock.unlock();
+
+	// Only this worker touches the node's state and the new children until
+	//  the tree is locked again: the others skip uninitialized nodes and
+	//  back off from nodes in expansion
+	return_t step_return = 0;
+	bool is_terminal = false;
+	int steps = 0;
+	NodeList children;
+	if (init_leaf) {
+		steps = simulate_rollout(ctx, node->state, leaf_choice,
+				sim_steps_per_node, step_return, is_terminal, false, true);
+	} else {
+		for (size_t i = 0; i < available_actions.size(); i++) {
+			UCTTreeNode* child = new UCTTreeNode(node, node->state,
+					sim_steps_per_node, available_actions[i], NULL);
+			return_t child_return;
+			int child_steps = simulate_rollout(ctx, child->state,
+					available_actions[i], sim_steps_per_node, child_return,
+					child->is_terminal, false, true);
+			child->init(child_steps, child_return);
+			child->accumulate_reward();
+			children.push_back(child);
+		}
+	}
+
+	lock.lock();
+	if (init_leaf) {
+		node->is_terminal = is_terminal;
+		node->init(steps, step_return);
+	} else {
+		m_expanded_nodes++;
+		node->v_children.swap(children);
+	}
+	add_virtual_loss(node, -m_virtual_loss);
+	--m_in_flight;
+	node->in_expansion = false;
+	return true;
+}
+
+int UCTSearchTree::leaf_parallel_monte_carlo(UCTTreeNode* node,
+		int num_steps, return_t &average_return) {
+	// Seeds are drawn here, in rollout order, so that the result does not
+	//  depend on which worker picks up which rollout
+	m_leaf_rollouts.resize(uct_num_monte_carlo);
+	for (int i = 0; i < uct_num_monte_carlo; ++i) {
+		LeafRollout& r = m_leaf_rollouts[i];
+		r.context.rng.seed(rand());
+		r.context.simulation_steps = 0;
+		r.context.context_time = 0;
+		r.context.emulation_time = 0;
+		r.steps = 0;
+		r.mc_return = 0;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_emulator_pool->run(uct_num_monte_carlo,
+			[this, node, num_steps](size_t i, StellaEnvironment* env) {
+				LeafRollout& r = m_leaf_rollouts[i];
+				r.context.env = env;
+				r.steps = do_monte_carlo(node, num_steps, r.mc_return,
+						&r.context);
+			});
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	m_parallel_time += std::chrono::duration_cast<
+			std::chrono::microseconds>(elapsed).count();
+
+	// Summed in rollout order, exactly like the serial loop
+	int sim_steps = 0;
+	average_return = 0.0;
+	for (int i = 0; i < uct_num_monte_carlo; ++i) {
+		LeafRollout& r = m_leaf_rollouts[i];
+		sim_steps += r.steps;
+		average_return += r.mc_return;
+		m_total_simulation_steps += r.context.simulation_steps;
+		m_context_time += r.context.context_time;
+		m_emulation_time += r.context.emulation_time;
+	}
+	average_return /= (float) uct_num_monte_carlo;
+	return sim_steps;
+}
+
+int UCTSearchTree::random_index(int n, RolloutContext* ctx) const {
+	if (ctx != NULL)
+		return ctx->rng() % n;
+	else
+		return rand() % n;
+}
+
+void UCTSearchTree::add_virtual_loss(UCTTreeNode* node, int delta) {
+	while (node != NULL) {
+		node->visit_count += delta;
+		node = (UCTTreeNode*) node->p_parent;
+	}
+}
+
 /* *********************************************************************
  Update the node values and counters from the current node, all the
  way up to the root
@@ -577,13 +1047,14 @@ void UCTSearchTree::update_values(UCTTreeNode* node, return_t mc_return) {
 				total_return * discount_factor);
 }
 
-vector<Action> UCTSearchTree::getEffectiveActionsVector(
-		const TreeNode* node) const {
+vector<Action> UCTSearchTree::getEffectiveActionsVector(const TreeNode* node,
+		RolloutContext* ctx) const {
 	vector<Action> usefulActions;
 	if (action_sequence_detection && trajectory.size() > dasd_sequence_length) {
 		vector<Action> p = getPreviousActions(node, dasd_sequence_length);
 		vector<bool> isUsefulAction = dasd->getEffectiveActions(p,
-				this->trajectory.size() * sim_steps_per_node);
+				this->trajectory.size() * sim_steps_per_node,
+				ctx != NULL ? &ctx->rng : NULL);
 		for (unsigned int a = 0; a < isUsefulAction.size(); ++a) {
 			if (isUsefulAction[a]) {
 				usefulActions.push_back((Action) a);
@@ -595,6 +1066,15 @@ vector<Action> UCTSearchTree::getEffectiveActionsVector(
 	return usefulActions;
 }
 
+void UCTSearchTree::print_profile_data(std::ostream& output) {
+	SearchTree::print_profile_data(output);
+	if (m_emulator_pool != NULL && m_parallel_mode != UCT_SERIAL) {
+		output << ",uct_parallel="
+				<< (m_parallel_mode == UCT_ROOT_PARALLEL ? "root" : "tree");
+		output << ",parallel_search_time=" << m_parallel_search_time;
+	}
+}
+
 void UCTSearchTree::print_tree() {
 	printf("*** TREE ***\n");
 	print_node((UCTTreeNode*) p_root);
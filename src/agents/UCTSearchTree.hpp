@@ -9,7 +9,9 @@
  * *****************************************************************************
  *  UCTSearchTree.hpp
  *
- *  A subclass of SearchTree that implements UCT. 
+ *  A subclass of SearchTree that implements UCT. With an emulator pool it can
+ *  also run root-parallel UCT (one independent tree per worker, merged at the
+ *  root) or tree-parallel UCT (all workers on one tree, with virtual loss).
  **************************************************************************** */
 
 #ifndef __UCT_SEARCH_TREE_HPP__
@@ -21,6 +23,9 @@
 #include "Settings.hxx"
 #include "Constants.h"
 
+#include <mutex>
+#include <random>
+
 class UCTSearchTree: public SearchTree {
 public:
 	/* *********************************************************************
@@ -29,6 +34,12 @@ public:
 	UCTSearchTree(RomSettings *, Settings &settings, ActionVect &actions,
 			StellaEnvironment* _env);
 
+	/* *********************************************************************
+	 Serial worker tree of a root-parallel search, with the configuration
+	 of parent (see SearchTree(const SearchTree&, StellaEnvironment*))
+	 ******************************************************************* */
+	UCTSearchTree(const UCTSearchTree& parent, StellaEnvironment* _env);
+
 	/* *********************************************************************
 	 Destructor
 	 ******************************************************************* */
@@ -51,6 +62,31 @@ public:
 	virtual void move_to_branch(Action a, int duration);
 
 protected:
+	// Emulator, random stream and counters of one worker of a parallel
+	// search; the counters are folded into the tree once the workers stop
+	struct RolloutContext {
+		StellaEnvironment* env;
+		std::mt19937 rng;
+		unsigned simulation_steps;
+		long long context_time;
+		long long emulation_time;
+	};
+
+	// One of the rollouts of a leaf run concurrently on the emulator pool
+	struct LeafRollout {
+		RolloutContext context;
+		int steps;
+		return_t mc_return;
+	};
+
+	enum ParallelMode {
+		UCT_SERIAL, UCT_ROOT_PARALLEL, UCT_TREE_PARALLEL
+	};
+
+	virtual void print_profile_data(std::ostream& output);
+
+	/** Also scales uct_monte_carlo_steps */
+	virtual void apply_budget_scale();
 
 	/* *********************************************************************
 	 Performs a single UCT iteration, starting from the root. Returns
@@ -58,17 +94,77 @@ protected:
 	 ******************************************************************* */
 	virtual int single_uct_iteration(void);
 
+	/** A UCT iteration that draws random numbers from ctx and runs its
+	 *  rollouts on ctx->env (rand() and m_env if ctx is NULL). In tree
+	 *  parallel mode it locks the tree around everything but the rollouts
+	 *  and returns -1 once the budget of the decision is spent. */
+	int uct_iteration(RolloutContext* ctx);
+
+	/** The serial search loop of update_tree() */
+	void update_tree_serial();
+
+	/* *********************************************************************
+	 Root parallelism: every worker grows its own tree from the root state
+	 with a share of the budget, then the visit counts and returns of the
+	 root children are summed into this tree.
+	 ******************************************************************* */
+	void update_tree_root_parallel();
+
+	/* *********************************************************************
+	 Tree parallelism: every worker iterates on this tree. A selected path
+	 carries a virtual loss of uct_virtual_loss visits until its rollouts
+	 are backed up, so that concurrent workers spread over the tree.
+	 ******************************************************************* */
+	void update_tree_tree_parallel();
+
+	/* *********************************************************************
+	 Leaf parallelism: runs the uct_num_monte_carlo rollouts of a leaf on
+	 the emulator pool, each with its own random stream, and averages them
+	 in order. Returns the simulated steps.
+	 ******************************************************************* */
+	int leaf_parallel_monte_carlo(UCTTreeNode* node, int num_steps,
+			return_t &average_return);
+
+	/** Creates one RolloutContext per worker of the pool */
+	void create_contexts();
+	/** Moves the counters of the contexts into the tree */
+	void merge_contexts();
+
+	/** Adds delta visits to every node from node up to the root */
+	void add_virtual_loss(UCTTreeNode* node, int delta);
+
+	/** Uniform index in [0, n) from ctx, or from rand() if ctx is NULL */
+	int random_index(int n, RolloutContext* ctx) const;
+
+	/** One rollout segment: simulate_game_err() on m_env, or the same on
+	 *  ctx->env with its random stream */
+	int simulate_rollout(RolloutContext* ctx, ALEState& state, Action act,
+			int num_steps, return_t &traj_return, bool &game_ended,
+			bool discount_return = true, bool save_state = false);
+
+	/* *********************************************************************
+	 Tree parallelism: simulates an uninitialized leaf (init_leaf) or all
+	 the children of a leaf on ctx->env, with the tree unlocked, then
+	 relocks it to link the results. The node carries a virtual loss
+	 meanwhile. Returns false, without unlocking, if another worker is
+	 already expanding the node.
+	 ******************************************************************* */
+	bool expand_unlocked(UCTTreeNode* node, bool init_leaf, Action leaf_choice,
+			RolloutContext* ctx, std::unique_lock<std::mutex>& lock);
+
 	/* *********************************************************************
 	 Returns the index of the first child with zero count
 	 Returns -1 if no such child is found
 	 ******************************************************************* */
-	int get_child_with_count_zero(const TreeNode* node) const;
+	int get_child_with_count_zero(const TreeNode* node,
+			RolloutContext* ctx = NULL) const;
 
 	/* *********************************************************************
 	 Returns the sub-branch with the highest value if add_uct_bias is true
 	 we will add the UCT bonus to each branch value and then take the max
 	 ******************************************************************* */
-	int get_best_branch(UCTTreeNode* node, bool add_uct_bias);
+	int get_best_branch(UCTTreeNode* node, bool add_uct_bias,
+			RolloutContext* ctx = NULL);
 
 	/** Most visited branch; used as an alternate action selection method */
 	int get_most_visited_branch(UCTTreeNode * node);
@@ -81,10 +177,11 @@ protected:
 
 	/* *********************************************************************
 	 Performs a Monte Carlo simulation from the given node, for
-	 i_uct_monte_carlo_steps steps
+	 i_uct_monte_carlo_steps steps. The caller accounts the rollout in
+	 m_generated_nodes and start_node->sim_steps.
 	 ******************************************************************* */
 	int do_monte_carlo(UCTTreeNode* start_node, int num_steps,
-			return_t &mc_return);
+			return_t &mc_return, RolloutContext* ctx = NULL);
 
 	/* *********************************************************************
 	 Update the node values and counters from the current node, all the
@@ -103,14 +200,40 @@ protected:
 
 	bool m_max_action;
 
-	std::vector<Action> getEffectiveActionsVector(const TreeNode* node) const;
+	// ctx, if given, supplies the random numbers of Avoidance
+	std::vector<Action> getEffectiveActionsVector(const TreeNode* node,
+			RolloutContext* ctx = NULL) const;
 
 protected:
 	int uct_max_simulations;
+	// uct_monte_carlo_steps from the settings, before any budget scaling
+	int m_simulation_budget;
 	int uct_search_depth; // Number of frames to simulate to when performing
 	// Monte-Carlo search
 	float uct_exploration_constant; // Exploration constant
 	int uct_num_monte_carlo;
+
+	Settings& m_settings;
+	ParallelMode m_parallel_mode;
+	int m_virtual_loss;
+
+	// Contexts of the pool workers, indexed like the pool
+	std::vector<RolloutContext*> m_contexts;
+	// Context of a root-parallel worker tree (NULL on the main tree)
+	RolloutContext* m_own_context;
+	// Trees of the root-parallel workers
+	std::vector<UCTSearchTree*> m_root_trees;
+	// Rollouts of the leaf being evaluated by leaf_parallel_monte_carlo()
+	std::vector<LeafRollout> m_leaf_rollouts;
+
+	// Tree parallelism: guards the tree and the fields below
+	std::mutex m_tree_mutex;
+	int m_parallel_steps;
+	int m_in_flight; // iterations between selection and backup
+	bool m_parallel_stop;
+
+	// Wall-clock microseconds spent in parallel search on this decision
+	long long m_parallel_search_time;
 };
 
 #endif // __UCT_SEARCH_TREE_HPP__
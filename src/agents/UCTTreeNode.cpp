@@ -18,7 +18,8 @@ UCTTreeNode::UCTTreeNode(TreeNode *parent, ALEState &parentState):
   TreeNode(parent, parentState),
   visit_count(0),
   sum_returns(0),
-  sim_steps(0)
+  sim_steps(0),
+  in_expansion(false)
 {
 }
 
@@ -27,5 +28,6 @@ UCTTreeNode::UCTTreeNode(TreeNode *parent, ALEState &parentState,
   TreeNode(parent, parentState, tree, a, num_simulate_steps),
   visit_count(0),
   sum_returns(0),
-  sim_steps(0) {
+  sim_steps(0),
+  in_expansion(false) {
 }
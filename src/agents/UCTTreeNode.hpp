@@ -40,6 +40,9 @@ public:
 	int visit_count; // The number of visits to this node
 	float sum_returns; // The sum of the returns received from this node
 	int sim_steps; // The Simulation of the rollout steps
+	// A tree-parallel worker is simulating this node or its children
+	//  with the tree unlocked
+	bool in_expansion;
 };
 
 #endif // __UCT_TREE_NODE_HPP__
@@ -92,6 +92,16 @@ void UniformCostSearch::expand_tree(TreeNode* start_node) {
        
 		bool leaf_node = (curr_node->v_children.empty());
 		m_expanded_nodes++;
+
+		// Simulate the children of a leaf as one batch
+		NodeList generated;
+		if (leaf_node) {
+			for (int a = 0; a < num_actions; a++)
+				generated.push_back(prepare_child(curr_node,
+						available_actions[a], sim_steps_per_node));
+			simulate_children();
+		}
+
 		// Expand all of its children (simulates the result)
 		for (int a = 0; a < num_actions; a++) {
 			Action act = available_actions[a];
@@ -101,11 +111,7 @@ void UniformCostSearch::expand_tree(TreeNode* start_node) {
 			// If re-expanding an internal node, don't creates new nodes
 			if (leaf_node) {
 				m_generated_nodes++;
-				child = new TreeNode(curr_node,	
-						curr_node->state,
-						this,
-						act,
-						sim_steps_per_node); 
+				child = generated[a];
 				// Miquel: Let's fix C = 10000
 				child->fn += ( m_max_reward - child->accumulated_reward ); // Miquel: add this to obtain Hector's BFS + m_max_reward * (720 - child->depth()) ;
 
@@ -132,15 +138,16 @@ void UniformCostSearch::expand_tree(TreeNode* start_node) {
 		}
 	
 		// Stop once we have simulated a maximum number of steps
-		if (num_simulated_steps >= max_sim_steps_per_frame) {
+		if (budget_spent(num_simulated_steps)) {
 			break;
 		}
 		
 	}
     
-	if (q.empty()) std::cout << "Search Space Exhausted!" << std::endl;
+	if (q.empty()) LOG(LOG_DEBUG, "Search Space Exhausted!\n");
 
 	
+	TRACE_SPAN("update_branch_return");
 	update_branch_return(start_node);
 }
 
@@ -229,5 +236,7 @@ void	UniformCostSearch::print_frame_data( int frame_number, float elapsed, Actio
 	output << ",tree_size=" <<  num_nodes(); 
 	output << ",best_action=" << action_to_string( curr_action );
 	output << ",branch_reward=" << get_root_value();
-	output << ",elapsed=" << elapsed << std::endl;
+	output << ",elapsed=" << elapsed;
+	print_profile_data(output);
+	output << std::endl;
 }
@@ -0,0 +1,93 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ale_planner.cpp
+ *
+ *  C API of the planners, on top of Planner.
+ **************************************************************************** */
+
+#include "ale_planner.h"
+#include "Planner.hpp"
+
+#include <cstring>
+
+struct ale_planner {
+	Planner* planner;
+};
+
+ale_planner* ale_planner_create(const char* rom_file,
+		const char* search_method, const char** settings) {
+	Planner::Options options;
+	options.push_back(std::make_pair("planner_quiet", "true"));
+	for (int i = 0; settings != NULL && settings[i] != NULL
+			&& settings[i + 1] != NULL; i += 2) {
+		options.push_back(std::make_pair(settings[i], settings[i + 1]));
+	}
+
+	Planner* planner = new Planner(rom_file, search_method, options);
+	if (!planner->ok()) {
+		delete planner;
+		return NULL;
+	}
+	ale_planner* p = new ale_planner;
+	p->planner = planner;
+	return p;
+}
+
+void ale_planner_destroy(ale_planner* p) {
+	if (p == NULL)
+		return;
+	delete p->planner;
+	delete p;
+}
+
+int ale_planner_plan(ale_planner* p, const char* state, size_t state_size,
+		int max_sim_steps, int max_planning_ms) {
+	Planner::Stats stats;
+	std::string serialized;
+	if (state != NULL)
+		serialized.assign(state, state_size);
+	Action action = p->planner->plan(serialized, max_sim_steps,
+			max_planning_ms, stats);
+	return action == UNDEFINED ? -1 : action;
+}
+
+void ale_planner_step(ale_planner* p, int action, int* reward,
+		int* terminal) {
+	bool game_ended;
+	reward_t r = p->planner->step((Action) action, game_ended);
+	if (reward != NULL)
+		*reward = r;
+	if (terminal != NULL)
+		*terminal = game_ended;
+}
+
+size_t ale_planner_get_state(ale_planner* p, char* buffer,
+		size_t buffer_size) {
+	std::string state = p->planner->current_state();
+	if (buffer != NULL && state.size() <= buffer_size)
+		memcpy(buffer, state.data(), state.size());
+	return state.size();
+}
+
+void ale_planner_get_stats(ale_planner* p, ale_planner_stats* stats) {
+	const Planner::Stats& s = p->planner->stats();
+	stats->action = s.action;
+	stats->expanded = s.expanded;
+	stats->generated = s.generated;
+	stats->depth = s.depth;
+	stats->tree_size = s.tree_size;
+	stats->root_value = s.root_value;
+	stats->elapsed_ms = s.elapsed_ms;
+	stats->reused = s.reused;
+}
+
+void ale_planner_reset(ale_planner* p) {
+	p->planner->reset();
+}
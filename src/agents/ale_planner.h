@@ -0,0 +1,84 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  ale_planner.h
+ *
+ *  C API of the planners, shipped in libaleplanner.a and libaleplanner.so.
+ *
+ *    const char* settings[] = {"max_sim_steps_per_frame", "1500", NULL};
+ *    ale_planner* p = ale_planner_create("pong.bin", "iw1", settings);
+ *    while (!terminal) {
+ *        int action = ale_planner_plan(p, NULL, 0, 0, 0);
+ *        ale_planner_step(p, action, &reward, &terminal);
+ *    }
+ *    ale_planner_destroy(p);
+ *
+ *  A planner is not thread-safe, but different planners can be used from
+ *  different threads once created. Create them from a single thread.
+ **************************************************************************** */
+
+#ifndef __ALE_PLANNER_H__
+#define __ALE_PLANNER_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ale_planner ale_planner;
+
+typedef struct {
+	int action;
+	unsigned expanded;
+	unsigned generated;
+	unsigned depth;
+	int tree_size;
+	float root_value;
+	double elapsed_ms;
+	int reused; /* 1 if the tree of the previous plan was reused */
+} ale_planner_stats;
+
+/* Loads a ROM and creates a planner of the given search method (see
+ * -search_method of the ale binary). settings is a NULL-terminated list of
+ * name, value pairs, with the names of the ale settings, or NULL. The
+ * search output on stdout is off unless planner_quiet is set to false.
+ * Returns NULL if the ROM cannot be loaded or the method is unknown. */
+ale_planner* ale_planner_create(const char* rom_file,
+		const char* search_method, const char** settings);
+
+void ale_planner_destroy(ale_planner* planner);
+
+/* Plans from a serialized ALEState (from the current state if state is
+ * NULL), which becomes the current state, and returns the best action.
+ * Budgets <= 0 fall back to the settings. Returns -1, keeping
+ * the current state, if state is not a serialized ALEState. */
+int ale_planner_plan(ale_planner* planner, const char* state,
+		size_t state_size, int max_sim_steps, int max_planning_ms);
+
+/* Plays an action for sim_steps_per_node frames from the current state */
+void ale_planner_step(ale_planner* planner, int action, int* reward,
+		int* terminal);
+
+/* Copies the current state, serialized, into buffer if it fits and returns
+ * its size */
+size_t ale_planner_get_state(ale_planner* planner, char* buffer,
+		size_t buffer_size);
+
+/* Statistics of the last plan */
+void ale_planner_get_stats(ale_planner* planner, ale_planner_stats* stats);
+
+/* Drops the tree and goes back to the start state of the game */
+void ale_planner_reset(ale_planner* planner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ALE_PLANNER_H__ */
@@ -0,0 +1,232 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  feature_bench_main.cpp
+ *
+ *  Entry point of ale-feature-bench, which times the novelty feature
+ *  extractors on recorded screens and RAM, without emulating:
+ *
+ *    ale-feature-bench dump <rom> <root states> <snapshots>
+ *      renders every state recorded with -record_root_states and writes
+ *      its screen and RAM to a snapshot corpus
+ *    ale-feature-bench run <rom> <snapshots> [-<setting> <value> ...]
+ *      calls getFeatures of every extractor bench_repeat times (default
+ *      10) on every snapshot
+ *
+ *  One line per extractor is printed, starting with "features=", with the
+ *  calls per second, the per-call latency (mean, p50, p99) in nanoseconds,
+ *  the heap allocations per call and the active features per call.
+ *  BasicFeatures with background subtraction is only run when bgpath is
+ *  set.
+ **************************************************************************** */
+
+#include "features/RAMBytes.hpp"
+#include "features/TFBinary.hpp"
+#include "features/ScreenPixels.hpp"
+#include "features/BasicFeatures.hpp"
+#include "features/BPROFeatures.hpp"
+#include "../ale_interface.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdint.h>
+
+// Heap allocations are counted while g_count_allocations is set
+static bool g_count_allocations = false;
+static unsigned long long g_allocations = 0;
+
+void* operator new(size_t size) {
+	if (g_count_allocations)
+		g_allocations++;
+	void* p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+struct Snapshot {
+	ALEScreen screen;
+	ALERAM ram;
+	Snapshot(int height, int width) :
+			screen(height, width) {
+	}
+};
+
+static void write_u32(std::ofstream& out, uint32_t value) {
+	out.write((const char*) &value, sizeof(value));
+}
+
+static bool read_u32(std::ifstream& in, uint32_t& value) {
+	return (bool) in.read((char*) &value, sizeof(value));
+}
+
+static int dump(const char* rom, const char* states_file,
+		const char* snapshots_file) {
+	ALEInterface ale(false);
+	ale.loadROM(rom);
+	StellaEnvironment* env = ale.environment.get();
+	ALEState base = env->cloneState();
+
+	std::ifstream in(states_file, std::ios::binary);
+	std::ofstream out(snapshots_file, std::ios::binary);
+	uint32_t size;
+	int n = 0;
+	while (read_u32(in, size)) {
+		std::string data(size, '\0');
+		if (!in.read(&data[0], size))
+			break;
+		env->restoreState(ALEState(base, data));
+		ALEScreen screen = env->buildAndGetScreen();
+		const ALERAM& ram = env->getRAM();
+
+		write_u32(out, screen.height());
+		write_u32(out, screen.width());
+		out.write((const char*) screen.getArray(), screen.arraySize());
+		write_u32(out, ram.size());
+		for (size_t i = 0; i < ram.size(); i++) {
+			char byte = ram.get(i);
+			out.write(&byte, 1);
+		}
+		n++;
+	}
+	printf("%d snapshots written to %s\n", n, snapshots_file);
+	return 0;
+}
+
+static bool read_snapshots(const char* path,
+		std::vector<Snapshot*>& snapshots) {
+	std::ifstream in(path, std::ios::binary);
+	uint32_t height, width, ram_size;
+	while (read_u32(in, height) && read_u32(in, width)) {
+		Snapshot* s = new Snapshot(height, width);
+		in.read((char*) s->screen.getArray(), s->screen.arraySize());
+		if (!read_u32(in, ram_size) || ram_size != s->ram.size()
+				|| !in.read((char*) s->ram.array(), ram_size)) {
+			delete s;
+			return false;
+		}
+		snapshots.push_back(s);
+	}
+	return true;
+}
+
+static void bench(const char* name, Features* feature,
+		std::vector<Snapshot*>& snapshots, int repeat) {
+	std::vector<bool> features;
+	std::vector<double> latencies;
+	latencies.reserve(snapshots.size() * repeat);
+	unsigned long long active = 0;
+	unsigned long long allocations = 0;
+	double total_ns = 0;
+
+	for (int r = 0; r < repeat; r++) {
+		for (size_t i = 0; i < snapshots.size(); i++) {
+			g_allocations = 0;
+			g_count_allocations = true;
+			auto start = std::chrono::steady_clock::now();
+			feature->getFeatures(snapshots[i]->screen, snapshots[i]->ram,
+					features);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			g_count_allocations = false;
+
+			double ns = std::chrono::duration_cast<
+					std::chrono::nanoseconds>(elapsed).count();
+			latencies.push_back(ns);
+			total_ns += ns;
+			allocations += g_allocations;
+			active += std::count(features.begin(), features.end(), true);
+		}
+	}
+
+	size_t calls = latencies.size();
+	std::sort(latencies.begin(), latencies.end());
+	printf("features=%s,calls=%d,calls_per_sec=%.1f,ns_per_call=%.1f,"
+			"p50_ns=%.0f,p99_ns=%.0f,allocs_per_call=%.2f,"
+			"active_per_call=%.1f\n", name, (int) calls,
+			calls / (total_ns / 1e9), total_ns / calls,
+			latencies[(calls - 1) / 2], latencies[(calls - 1) * 99 / 100],
+			(double) allocations / calls, (double) active / calls);
+	fflush(stdout);
+}
+
+static int run(int argc, char** argv) {
+	ALEInterface ale(false);
+	Settings& settings = ale.theOSystem->settings();
+	for (int i = 4; i + 1 < argc; i += 2) {
+		const char* name = argv[i];
+		if (name[0] == '-')
+			name++;
+		settings.setString(name, argv[i + 1]);
+	}
+	ale.loadROM(argv[2]);
+	RomSettings* rom_settings = ale.settings.get();
+	StellaEnvironment* env = ale.environment.get();
+	ActionVect actions = rom_settings->getAllActions();
+
+	std::vector<Snapshot*> snapshots;
+	if (!read_snapshots(argv[3], snapshots) || snapshots.empty()) {
+		fprintf(stderr, "Could not read any snapshot from %s\n", argv[3]);
+		return 1;
+	}
+	int repeat = settings.getInt("bench_repeat", false);
+	if (repeat <= 0)
+		repeat = 10;
+
+	std::vector<std::pair<std::string, Features*> > extractors;
+	extractors.push_back(std::make_pair("RAMBytes", new RAMBytes(env)));
+	extractors.push_back(std::make_pair("TFBinary", new TFBinary(env)));
+	extractors.push_back(
+			std::make_pair("ScreenPixels", new ScreenPixels(env)));
+	settings.setBool("get_background", false);
+	extractors.push_back(
+			std::make_pair("BasicFeatures",
+					new BasicFeatures(rom_settings, settings, actions,
+							env)));
+	extractors.push_back(
+			std::make_pair("BPROFeatures",
+					new BPROFeatures(rom_settings, settings, actions, env)));
+	if (!settings.getString("bgpath", false).empty()) {
+		settings.setBool("get_background", true);
+		extractors.push_back(
+				std::make_pair("BasicFeatures+Background",
+						new BasicFeatures(rom_settings, settings, actions,
+								env)));
+	}
+
+	for (size_t i = 0; i < extractors.size(); i++) {
+		bench(extractors[i].first.c_str(), extractors[i].second, snapshots,
+				repeat);
+		delete extractors[i].second;
+	}
+	for (size_t i = 0; i < snapshots.size(); i++) {
+		delete snapshots[i];
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	std::string mode = (argc > 1 ? argv[1] : "");
+	if (mode == "dump" && argc == 5) {
+		return dump(argv[2], argv[3], argv[4]);
+	} else if (mode == "run" && argc >= 4 && argc % 2 == 0) {
+		return run(argc, argv);
+	}
+	fprintf(stderr, "Usage: %s dump <rom> <root states> <snapshots>\n"
+			"       %s run <rom> <snapshots> [-<setting> <value> ...]\n",
+			argv[0], argv[0]);
+	return 1;
+}
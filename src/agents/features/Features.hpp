@@ -82,6 +82,13 @@ public:
 	virtual void getFeatures(const ALEScreen &screen, const ALERAM &ram,
 			vector<bool>& features) = 0;
 	virtual int getNumberOfFeatures();
+	/**
+	 * Whether getFeatures looks at the screen. When it does not, callers may
+	 * pass any screen and skip restoring and rendering the state.
+	 */
+	virtual bool usesScreen() {
+		return true;
+	}
 	/**
 	 * Destructor, not necessary in this class.
 	 */
@@ -19,6 +19,10 @@ public:
 	void getFeatures(const ALEScreen &screen, const ALERAM &ram,
 			vector<bool>& features);
 
+	bool usesScreen() {
+		return false;
+	}
+
 
 private:
 	int redundant_ram;
@@ -18,6 +18,10 @@ public:
 	void getFeatures(const ALEScreen &screen, const ALERAM &ram,
 			vector<bool>& features);
 
+	bool usesScreen() {
+		return false;
+	}
+
 
 };
 
@@ -14,6 +14,16 @@ MODULE_OBJS := \
 	src/agents/DominatedActionSequenceDetection.o \
 	src/agents/SearchTree.o \
 	src/agents/TreeNode.o \
+	src/agents/TreeReclaimer.o \
+	src/agents/Telemetry.o \
+	src/agents/Tracing.o \
+	src/agents/Logger.o \
+	src/agents/PerfCounters.o \
+	src/agents/EmulatorPool.o \
+	src/agents/ProcessEmulatorPool.o \
+	src/agents/Planner.o \
+	src/agents/PlanningServer.o \
+	src/agents/ale_planner.o \
 	src/agents/FullSearchTree.o \
 	src/agents/UCTSearchTree.o \
 	src/agents/UCTTreeNode.o \
@@ -22,6 +32,7 @@ MODULE_OBJS := \
 	src/agents/BreadthFirstSearch.o \
 	src/agents/IW1Search.o \
 	src/agents/PIW1Search.o \
+	src/agents/ParallelIW1Search.o \
 	src/agents/BestFirstSearch.o \
 	src/agents/BondPercolation.o \
 	src/agents/SitePercolation.o \
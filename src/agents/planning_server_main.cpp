@@ -0,0 +1,47 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  planning_server_main.cpp
+ *
+ *  Entry point of ale-planning-server:
+ *
+ *    ale-planning-server <socket path> [-<setting> <value> ...]
+ *
+ *  The settings are the ones of the ale binary and apply to every emulator
+ *  the server loads.
+ **************************************************************************** */
+
+#include "PlanningServer.hpp"
+
+#include <cstdio>
+#include <csignal>
+
+int main(int argc, char** argv) {
+	if (argc < 2 || argc % 2 != 0) {
+		fprintf(stderr,
+				"Usage: %s <socket path> [-<setting> <value> ...]\n",
+				argv[0]);
+		return 1;
+	}
+
+	Planner::Options options;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		const char* name = argv[i];
+		if (name[0] == '-')
+			name++;
+		options.push_back(std::make_pair(name, argv[i + 1]));
+	}
+
+	// A client that hangs up must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+
+	PlanningServer server(argv[1], options);
+	server.serve();
+	return 0;
+}
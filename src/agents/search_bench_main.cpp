@@ -0,0 +1,154 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  search_bench_main.cpp
+ *
+ *  Entry point of ale-search-bench, which times the search methods on a
+ *  corpus of root states recorded with -record_root_states:
+ *
+ *    ale-search-bench <rom> <corpus> <method,...|all> [-<setting> <value> ...]
+ *
+ *  Every method plans once from every state of the corpus, from scratch
+ *  and with rand() seeded by random_seed plus the index of the state. One
+ *  line per method is printed, starting with "method=", with a digest of
+ *  the actions and node counts of every decision, the nodes generated per
+ *  second, the share of the planning time spent emulating, restoring
+ *  states and computing novelty features, the bytes per node of the trees
+ *  and the decision latency percentiles in milliseconds.
+ **************************************************************************** */
+
+#include "Planner.hpp"
+#include "SearchTree.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+static const char* all_methods = "brfs,iw1,piw1,bfs,ucs,uct,brute,sips,bips";
+
+static bool read_corpus(const char* path, std::vector<std::string>& states) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return false;
+	uint32_t size;
+	while (in.read((char*) &size, sizeof(size))) {
+		std::string state(size, '\0');
+		if (!in.read(&state[0], size))
+			return false;
+		states.push_back(state);
+	}
+	return true;
+}
+
+// FNV-1a, over what a decision must reproduce exactly
+static void hash_decision(uint64_t& digest, const Planner::Stats& stats) {
+	const int64_t values[] = { stats.action, stats.expanded, stats.generated,
+			stats.depth, stats.tree_size };
+	const unsigned char* bytes = (const unsigned char*) values;
+	for (size_t i = 0; i < sizeof(values); ++i) {
+		digest ^= bytes[i];
+		digest *= 1099511628211ULL;
+	}
+}
+
+static double percentile(std::vector<double> values, int p) {
+	std::sort(values.begin(), values.end());
+	return values[(values.size() - 1) * p / 100];
+}
+
+int main(int argc, char** argv) {
+	if (argc < 4 || argc % 2 != 0) {
+		fprintf(stderr, "Usage: %s <rom> <corpus> <method,...|all> "
+				"[-<setting> <value> ...]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> states;
+	if (!read_corpus(argv[2], states) || states.empty()) {
+		fprintf(stderr, "Could not read any state from %s\n", argv[2]);
+		return 1;
+	}
+
+	Planner::Options options;
+	options.push_back(std::make_pair("planner_quiet", "true"));
+	int seed = 0;
+	for (int i = 4; i + 1 < argc; i += 2) {
+		const char* name = argv[i];
+		if (name[0] == '-')
+			name++;
+		options.push_back(std::make_pair(name, argv[i + 1]));
+		if (std::string(name) == "random_seed")
+			seed = atoi(argv[i + 1]);
+	}
+
+	std::string methods = argv[3];
+	if (methods == "all")
+		methods = all_methods;
+	std::istringstream method_list(methods);
+	std::string method;
+	while (std::getline(method_list, method, ',')) {
+		Planner planner(argv[1], method, options);
+		if (!planner.ok()) {
+			fprintf(stderr, "Unknown search method: %s\n", method.c_str());
+			return 1;
+		}
+		SearchTree* tree = planner.tree();
+
+		unsigned long long generated = 0, expanded = 0;
+		uint64_t digest = 14695981039346656037ULL;
+		long long emulation_time = 0, context_time = 0, feature_time = 0;
+		double bytes_per_node = 0;
+		std::vector<double> latencies;
+		for (size_t i = 0; i < states.size(); ++i) {
+			srand(seed + i);
+			planner.reset();
+			long long emulation_start = tree->emulation_time();
+			long long context_start = tree->context_time();
+			long long feature_start = tree->feature_time();
+
+			Planner::Stats stats;
+			planner.plan(states[i], 0, 0, stats);
+
+			generated += stats.generated;
+			expanded += stats.expanded;
+			hash_decision(digest, stats);
+			emulation_time += tree->emulation_time() - emulation_start;
+			context_time += tree->context_time() - context_start;
+			feature_time += tree->feature_time() - feature_start;
+			if (stats.tree_size > 0)
+				bytes_per_node += (double) tree->tree_bytes()
+						/ stats.tree_size;
+			latencies.push_back(stats.elapsed_ms);
+		}
+
+		double total_ms = 0;
+		for (size_t i = 0; i < latencies.size(); ++i)
+			total_ms += latencies[i];
+		double total_us = total_ms * 1000;
+		printf("method=%s,decisions=%d,digest=%016llx,expanded=%llu,"
+				"generated=%llu,nodes_per_sec=%.1f,"
+				"emulation_share=%.3f,context_share=%.3f,feature_share=%.3f,"
+				"bytes_per_node=%.1f,latency_p50=%.2f,latency_p90=%.2f,"
+				"latency_p99=%.2f,latency_max=%.2f\n", method.c_str(),
+				(int) latencies.size(), (unsigned long long) digest, expanded,
+				generated,
+				total_ms > 0 ? generated / (total_ms / 1000) : 0,
+				total_us > 0 ? emulation_time / total_us : 0,
+				total_us > 0 ? context_time / total_us : 0,
+				total_us > 0 ? feature_time / total_us : 0,
+				bytes_per_node / latencies.size(), percentile(latencies, 50),
+				percentile(latencies, 90), percentile(latencies, 99),
+				percentile(latencies, 100));
+		fflush(stdout);
+	}
+	return 0;
+}
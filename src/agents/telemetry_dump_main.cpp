@@ -0,0 +1,58 @@
+/* *****************************************************************************
+ * A.L.E (Arcade Learning Environment)
+ * Copyright (c) 2009-2012 by Yavar Naddaf, Joel Veness, Marc G. Bellemare
+ * Released under GNU General Public License www.gnu.org/licenses/gpl-3.0.txt
+ *
+ * Based on: Stella  --  "An Atari 2600 VCS Emulator"
+ * Copyright (c) 1995-2007 by Bradford W. Mott and the Stella team
+ *
+ * *****************************************************************************
+ *  telemetry_dump_main.cpp
+ *
+ *  Entry point of ale-telemetry-dump, which turns the binary telemetry of
+ *  -trace_format binary back into text, one record at a time:
+ *
+ *    ale-telemetry-dump [-tsv] <telemetry file> ...
+ *
+ *  Records are printed as the key=value lines of the text trace, or as
+ *  tab-separated values under a single header line with -tsv.
+ **************************************************************************** */
+
+#include "Telemetry.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv) {
+	bool tsv = false;
+	int first = 1;
+	if (argc > 1 && strcmp(argv[1], "-tsv") == 0) {
+		tsv = true;
+		first = 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "Usage: %s [-tsv] <telemetry file> ...\n", argv[0]);
+		return 1;
+	}
+
+	if (tsv)
+		print_telemetry_tsv_header(std::cout);
+	for (int i = first; i < argc; ++i) {
+		TelemetryReader reader(argv[i]);
+		if (!reader.ok()) {
+			fprintf(stderr, "%s is not a telemetry file of this version\n",
+					argv[i]);
+			return 1;
+		}
+		TelemetryRecord record;
+		while (reader.next(record)) {
+			if (tsv)
+				print_telemetry_tsv(record, std::cout);
+			else
+				print_telemetry_record(record, std::cout);
+		}
+	}
+	std::cout.flush();
+	return 0;
+}